@@ -96,6 +96,15 @@ namespace trapdoor {
     bool Configuration::readShortcutConfigs() {
         try {
             auto cc = this->config["shortcuts"];
+            auto addShortcut = [this](const std::string& key, Shortcut& sh) {
+                std::string error;
+                if (!sh.compile(error)) {
+                    trapdoor::logger().error("Shortcut {}: {}", key, error);
+                    return;
+                }
+                this->shortcuts.push_back(std::move(sh));
+                trapdoor::logger().debug("Shortcut: {}", this->shortcuts.back().getDescription());
+            };
             for (const auto& i : cc.items()) {
                 Shortcut sh;
                 const auto& value = i.value();
@@ -112,22 +121,19 @@ namespace trapdoor {
                     sh.type = ShortcutType::USE;
                     sh.setItem(value["item"].get<std::string>());
                     sh.prevent = value["prevent"].get<bool>();
-                    this->shortcuts.push_back(sh);
-                    trapdoor::logger().debug("Shortcut: {}", sh.getDescription());
+                    addShortcut(i.key(), sh);
                 } else if (type == "use-on") {
                     sh.type = ShortcutType::USE_ON;
                     sh.setItem(value["item"].get<std::string>());
                     sh.setBlock(value["block"].get<std::string>());
                     sh.prevent = value["prevent"].get<bool>();
-                    this->shortcuts.push_back(sh);
-                    trapdoor::logger().debug("Shortcut: {}", sh.getDescription());
+                    addShortcut(i.key(), sh);
                 } else if (type == "destroy") {
                     sh.type = ShortcutType::DESTROY;
                     sh.setItem(value["item"].get<std::string>());
                     sh.setBlock(value["block"].get<std::string>());
                     sh.prevent = value["prevent"].get<bool>();
-                    this->shortcuts.push_back(sh);
-                    trapdoor::logger().debug("Shortcut: {}", sh.getDescription());
+                    addShortcut(i.key(), sh);
                 }
 
                 else if (type == "command") {
@@ -138,6 +144,7 @@ namespace trapdoor {
                     trapdoor::logger().error("unknown shortcut type: {}", type);
                 }
             }
+            this->shortcutIndex.build(this->shortcuts);
         } catch (const std::exception& e) {
             trapdoor::logger().error("error read shortcut getConfig: {}", e.what());
             return false;
@@ -43,11 +43,16 @@ namespace trapdoor {
         hsaManager.HeavyTick();
         HUDHelper.tick();
         slimeChunkHelper.HeavyTick();
+        spawnHelper.heavyTick();
     }
     void TrapdoorMod::lightTick() {
         villageHelper.lightTick();
         hopperChannelManager.tick();
         this->spawnAnalyzer.tick();
+        this->spawnHelper.lightTick();
+        this->mobCapMonitor.tick();
+        this->simPlayerManager.tick();
+        this->entityIndex.tick();
     }
 
     Logger &logger() {
@@ -61,6 +66,7 @@ namespace trapdoor {
         trapdoor::SubscribeEvents();
         trapdoor::initRotateBlockHelper();
         trapdoor::setupCommands();
+        this->hsaManager.load("./plugins/trapdoor/hsa.bin");
     }
 
     bool TrapdoorMod::initConfig() {
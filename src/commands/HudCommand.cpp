@@ -22,8 +22,7 @@ namespace trapdoor {
         command->mandatory("hud", ParamType::Enum, showOpt,
                            CommandParameterOption::EnumAutocompleteExpansion);
 
-        auto &showItemsOpt = command->setEnum(
-            "showItems", {"base", "mspt", "hopper", "village", "redstone", "chunk"});
+        auto &showItemsOpt = command->setEnum("showItems", HUDHelper::getSectionNames());
 
         command->mandatory("itemType", ParamType::Enum, showItemsOpt,
                            CommandParameterOption::EnumAutocompleteExpansion);
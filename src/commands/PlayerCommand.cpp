@@ -26,6 +26,9 @@ namespace trapdoor {
         auto backpackOpt = command->setEnum("backpackOpt", {"backpack"});
         auto stopOpt = command->setEnum("stopOpt", {"stop", "cancel"});
         auto setOpt = command->setEnum("setOpt", {"set", "drop"});
+        auto runOpt = command->setEnum("runOpt", {"run"});
+        auto execOpt = command->setEnum("execOpt", {"exec"});
+        auto batchOpt = command->setEnum("batchOpt", {"batch"});
 
         command->mandatory("player", ParamType::Enum, spawnOpt,
                            CommandParameterOption::EnumAutocompleteExpansion);
@@ -56,6 +59,12 @@ namespace trapdoor {
 
         command->mandatory("player", ParamType::Enum, setOpt,
                            CommandParameterOption::EnumAutocompleteExpansion);
+        command->mandatory("player", ParamType::Enum, runOpt,
+                           CommandParameterOption::EnumAutocompleteExpansion);
+        command->mandatory("player", ParamType::Enum, execOpt,
+                           CommandParameterOption::EnumAutocompleteExpansion);
+        command->mandatory("batch", ParamType::Enum, batchOpt,
+                           CommandParameterOption::EnumAutocompleteExpansion);
 
         //      command->mandatory("name", ParamType::String);
         //        command->addSoftEnumValues("name", {});
@@ -71,6 +80,9 @@ namespace trapdoor {
         command->optional("times", ParamType::Int);
 
         command->optional("slot", ParamType::Int);
+        command->mandatory("scriptName", ParamType::String);
+        command->mandatory("script", ParamType::RawText);
+        command->mandatory("targets", ParamType::Player);
 
         // clang-format off
         //  cancel task and stop action
@@ -98,6 +110,12 @@ namespace trapdoor {
         command->addOverload({"name", attackOpt, "repeatType", "interval", "times"});
         //jump
         command->addOverload({"name", jumpOpt, "repeatType", "interval", "times"});
+        // action sequence
+        command->addOverload({"name", runOpt, "scriptName"});
+        command->addOverload({"name", execOpt, "script"});
+        // 选择器选中的所有假人执行同一个序列
+        command->addOverload({batchOpt, "targets", runOpt, "scriptName"});
+        command->addOverload({batchOpt, "targets", execOpt, "script"});
 
 
         command->addOverload(std::vector<std::string>());
@@ -107,8 +125,19 @@ namespace trapdoor {
         auto cb = [](DynamicCommand const &command, CommandOrigin const &origin,
                      CommandOutput &output,
                      std::unordered_map<std::string, DynamicCommand::Result> &results) {
+            std::vector<std::string> names;
+            if (results["batch"].isSet) {
+                for (auto *p : results["targets"].get<std::vector<Player *>>()) {
+                    if (p) names.push_back(p->getRealName());
+                }
+                if (names.empty()) {
+                    output.error("No player is selected");
+                    return;
+                }
+            }
             auto name = results["name"].isSet ? results["name"].get<std::string>() : std::string();
-            if (name.empty()) {
+            if (!name.empty()) names = {name};
+            if (names.empty()) {
                 trapdoor::mod().getSimPlayerManager().listAll().sendTo(output);
                 return;
             }
@@ -219,6 +248,18 @@ namespace trapdoor {
                     }
 
                     break;
+                case do_hash("run"):
+                    trapdoor::mod()
+                        .getSimPlayerManager()
+                        .runScriptFile(names, results["scriptName"].get<std::string>())
+                        .sendTo(output);
+                    break;
+                case do_hash("exec"):
+                    trapdoor::mod()
+                        .getSimPlayerManager()
+                        .runScript(names, results["script"].get<std::string>())
+                        .sendTo(output);
+                    break;
                 case do_hash("cancel"):
                     trapdoor::mod().getSimPlayerManager().cancel(name);
                     break;
@@ -15,7 +15,7 @@ namespace trapdoor {
         auto command = DynamicCommand::createCommand("prof", "profile world health",
                                                      static_cast<CommandPermissionLevel>(level));
 
-        auto &optContinue = command->setEnum("opt", {"normal", "chunk", "pt", "entity"});
+        auto &optContinue = command->setEnum("opt", {"normal", "chunk", "pt", "entity", "sim"});
         command->mandatory("prof", ParamType::Enum, optContinue,
                            CommandParameterOption::EnumAutocompleteExpansion);
         command->optional("numberOfTick", ParamType::Int);
@@ -43,6 +43,9 @@ namespace trapdoor {
                 case do_hash("entity"):
                     trapdoor::startProfiler(tickTime, SimpleProfiler::Entity).sendTo(output);
                     break;
+                case do_hash("sim"):
+                    trapdoor::startProfiler(tickTime, SimpleProfiler::Sim).sendTo(output);
+                    break;
                 case do_hash("pt"):
                     ErrorMsg("Function is developing by developer").sendTo(output);
                     break;
@@ -7,6 +7,7 @@
 #include "CommandHelper.h"
 #include "DynamicCommandAPI.h"
 #include "Msg.h"
+#include "Shortcuts.h"
 #include "TrapdoorMod.h"
 namespace trapdoor {
     void registerShortcutCommand(const std::string &shortcut,
@@ -16,22 +17,28 @@ namespace trapdoor {
             trapdoor::logger().debug("        - {}", action);
         }
 
+        std::vector<ActionTemplate> templates;
+        std::string error;
+        auto allowed = PLAYER_ARGS | argBit(ShortcutArg::PDim);
+        if (!compileActions(actions, allowed, templates, error)) {
+            trapdoor::logger().error("Shortcut command {}: {}", shortcut, error);
+            return;
+        }
+
         using ParamType = DynamicCommand::ParameterType;
         auto description = "Shortcut for /" + actions[0] + " ...";
         auto command = DynamicCommand::createCommand(shortcut, description);
         command->addOverload(std::vector<std::string>{});
-        auto cb = [actions](DynamicCommand const &command, CommandOrigin const &origin,
-                            CommandOutput &output,
-                            std::unordered_map<std::string, DynamicCommand::Result> &results) {
+        auto cb = [templates, buffer = std::string()](
+                      DynamicCommand const &command, CommandOrigin const &origin,
+                      CommandOutput &output,
+                      std::unordered_map<std::string, DynamicCommand::Result> &results) mutable {
             auto *p = origin.getPlayer();
             if (p) {
-                auto pos = p->getPos().toBlockPos();
-                auto dim = p->getDimensionId();
-                for (const auto &act : actions) {
-                    auto cmd = fmt::format(act, fmt::arg("px", pos.x), fmt::arg("py", pos.y),
-                                           fmt::arg("pz", pos.z), fmt::arg("pdim", dim));
-                    p->runcmd(cmd);
-                }
+                ShortcutArgs args;
+                args.playerPos = p->getPos().toBlockPos();
+                args.dim = p->getDimensionId();
+                runActions(p, templates, args, buffer);
             }
         };
         command->setCallback(cb);
@@ -14,18 +14,27 @@ namespace trapdoor{
         auto &showEnum = command->setEnum("showSubCommand", {"show"});
         auto &cleanEnum = command->setEnum("cleanSubCommand", {"clear"});
         auto &rangeEnum = command->setEnum("rangeSubCommand", {"range"});
+        auto &findEnum = command->setEnum("findSubCommand", {"find"});
+        auto &findCtlEnum = command->setEnum("findCtlSubCommand", {"status", "cancel"});
         command->mandatory("slime", ParamType::Enum, showEnum,
                            CommandParameterOption::EnumAutocompleteExpansion);
         command->mandatory("slime", ParamType::Enum, cleanEnum,
                            CommandParameterOption::EnumAutocompleteExpansion);
         command->mandatory("slime", ParamType::Enum, rangeEnum,
                            CommandParameterOption::EnumAutocompleteExpansion);
+        command->mandatory("slime", ParamType::Enum, findEnum,
+                           CommandParameterOption::EnumAutocompleteExpansion);
+        command->mandatory("slime", ParamType::Enum, findCtlEnum,
+                           CommandParameterOption::EnumAutocompleteExpansion);
         command->mandatory("onoroff", ParamType::Bool);
         command->mandatory("range", ParamType::Int);
+        command->optional("window", ParamType::Int);
 
         command->addOverload({showEnum, "onoroff"});
         command->addOverload({cleanEnum});
         command->addOverload({rangeEnum, "range"});
+        command->addOverload({findEnum, "range", "window"});
+        command->addOverload({findCtlEnum});
 
         auto cb = [](DynamicCommand const &command, CommandOrigin const &origin,
                      CommandOutput &output,
@@ -53,6 +62,20 @@ namespace trapdoor{
                         .setRadius(results["range"].getRaw<int>())
                         .sendTo(output);
                     break;
+                case do_hash("find"):
+                    trapdoor::mod()
+                        .getSlimeChunkHelper()
+                        .startFind(reinterpret_cast<Player *>(origin.getPlayer()),
+                                   results["range"].getRaw<int>(),
+                                   results["window"].isSet ? results["window"].getRaw<int>() : 4)
+                        .sendTo(output);
+                    break;
+                case do_hash("status"):
+                    trapdoor::mod().getSlimeChunkHelper().printFindStatus().sendTo(output);
+                    break;
+                case do_hash("cancel"):
+                    trapdoor::mod().getSlimeChunkHelper().cancelFind().sendTo(output);
+                    break;
             }
         };
 
@@ -26,6 +26,13 @@ namespace trapdoor {
         auto &analyzeSubOpt =
             command->setEnum("analyze options", {"start", "stop", "print", "clear"});
 
+        auto &capOpt = command->setEnum("capcmd", {"cap"});
+
+        auto &heatmapOpt = command->setEnum("heatmap", {"heatmap"});
+        auto &heatmapChunkOpt = command->setEnum("heatmap chunk", {"chunk"});
+        auto &heatmapAreaOpt = command->setEnum("heatmap area", {"area"});
+        auto &heatmapSubOpt = command->setEnum("heatmap options", {"info", "clear"});
+
         // mandatory/options就是给enum增加后置参数类型的,mandatory就是必填,optional是选填
         command->mandatory("spawn", ParamType::Enum, optCount,
                            CommandParameterOption::EnumAutocompleteExpansion);
@@ -45,8 +52,35 @@ namespace trapdoor {
         command->mandatory("analyzeSub", ParamType::Enum, analyzeSubOpt,
                            CommandParameterOption::EnumAutocompleteExpansion);
 
+        command->mandatory("spawn", ParamType::Enum, capOpt,
+                           CommandParameterOption::EnumAutocompleteExpansion);
+
+        command->mandatory("spawn", ParamType::Enum, heatmapOpt,
+                           CommandParameterOption::EnumAutocompleteExpansion);
+
+        command->mandatory("heatmapSub", ParamType::Enum, heatmapChunkOpt,
+                           CommandParameterOption::EnumAutocompleteExpansion);
+
+        command->mandatory("heatmapSub", ParamType::Enum, heatmapAreaOpt,
+                           CommandParameterOption::EnumAutocompleteExpansion);
+
+        command->mandatory("heatmapSub", ParamType::Enum, heatmapSubOpt,
+                           CommandParameterOption::EnumAutocompleteExpansion);
+
         command->mandatory("actorType", ParamType::ActorType);
 
+        command->optional("radius", ParamType::Int);
+
+        command->optional("samplingRate", ParamType::Int);
+
+        command->mandatory("pool", ParamType::Int);
+
+        command->mandatory("limit", ParamType::Int);
+
+        command->mandatory("from", ParamType::BlockPos);
+
+        command->mandatory("to", ParamType::BlockPos);
+
         command->optional("blockPos", ParamType::BlockPos);
 
         // 添加子命令并进行类型绑定
@@ -56,7 +90,14 @@ namespace trapdoor {
         // overload就是增加一些子命令，子命令需要Enum；并设定后面需要接什么类型的参数
         command->addOverload({optCount, "countType"});
 
-        command->addOverload({analyzeOpt, "analyzeSub"});
+        command->addOverload({analyzeOpt, "analyzeSub", "samplingRate"});
+
+        command->addOverload({capOpt});
+        command->addOverload({capOpt, "pool", "limit"});
+
+        command->addOverload({heatmapOpt, heatmapChunkOpt, "radius"});
+        command->addOverload({heatmapOpt, heatmapAreaOpt, "from", "to"});
+        command->addOverload({heatmapOpt, heatmapSubOpt});
 
         auto cb = [](DynamicCommand const &command, CommandOrigin const &origin,
                      CommandOutput &output,
@@ -83,7 +124,10 @@ namespace trapdoor {
                         trapdoor::mod()
                             .getSpawnAnalyzer()
                             .start(origin.getDimension()->getDimensionId(),
-                                   fromBlockPos(origin.getBlockPosition()).toChunkPos())
+                                   fromBlockPos(origin.getBlockPosition()).toChunkPos(),
+                                   results["samplingRate"].isSet
+                                       ? results["samplingRate"].get<int>()
+                                       : SpawnAnalyzer::SAMPLING_RARE)
                             .sendTo(output);
                     } else if (subOpt == "stop") {
                         trapdoor::mod().getSpawnAnalyzer().stop().sendTo(output);
@@ -93,6 +137,40 @@ namespace trapdoor {
                         trapdoor::mod().getSpawnAnalyzer().clear().sendTo(output);
                     }
                     break;
+                case do_hash("cap"):
+                    if (results["pool"].isSet) {
+                        trapdoor::mod()
+                            .getMobCapMonitor()
+                            .setCap(results["pool"].get<int>(), results["limit"].get<int>())
+                            .sendTo(output);
+                    } else {
+                        trapdoor::mod()
+                            .getMobCapMonitor()
+                            .printSummary(origin.getDimension()->getDimensionId())
+                            .sendTo(output);
+                    }
+                    break;
+                case do_hash("heatmap"): {
+                    auto &helper = trapdoor::mod().getSpawnHelper();
+                    auto *player = reinterpret_cast<Player *>(origin.getPlayer());
+                    auto heatmapSub = results["heatmapSub"].getRaw<std::string>();
+                    if (heatmapSub == "chunk") {
+                        helper
+                            .showChunkRadius(
+                                player, results["radius"].isSet ? results["radius"].get<int>() : 1)
+                            .sendTo(output);
+                    } else if (heatmapSub == "area") {
+                        helper
+                            .showArea(player, results["from"].get<BlockPos>(),
+                                      results["to"].get<BlockPos>())
+                            .sendTo(output);
+                    } else if (heatmapSub == "info") {
+                        helper.printInfo().sendTo(output);
+                    } else if (heatmapSub == "clear") {
+                        helper.clear().sendTo(output);
+                    }
+                    break;
+                }
                 case do_hash("prob"):
                     if (results["blockPos"].isSet) {
                         trapdoor::printSpawnProbability(
@@ -7,13 +7,19 @@
 #include <MC/Dimension.hpp>
 #include <MC/Level.hpp>
 #include <MC/LevelChunk.hpp>
+#include <chrono>
+#include <random>
 #include <string>
+#include <vector>
 
+#include "BlockRotateHelper.h"
 #include "CommandHelper.h"
 #include "DynamicCommandAPI.h"
 #include "MCTick.h"
+#include "Msg.h"
 #include "Particle.h"
 #include "ScheduleAPI.h"
+#include "SlimeKernel.h"
 namespace trapdoor {
     void test_particle(Player * p) {
         //        Schedule::repeat(
@@ -23,6 +29,42 @@ namespace trapdoor {
         //            20);
     }
 
+    // 对比std::mt19937、单个种子的快速内核和批量内核计算史莱姆区块的耗时
+    ActionResult test_slime(int radius) {
+        if (radius <= 0) radius = 64;
+        const auto side = static_cast<size_t>(radius) * 2;
+        using clock = std::chrono::steady_clock;
+        auto nsPerChunk = [side](clock::time_point a, clock::time_point b) {
+            return std::chrono::duration<double, std::nano>(b - a).count() /
+                   static_cast<double>(side * side);
+        };
+        size_t ref = 0, fast = 0, batch = 0;
+        auto t0 = clock::now();
+        for (int z = -radius; z < radius; z++) {
+            for (int x = -radius; x < radius; x++) {
+                std::mt19937 mt(slimeSeed(x, z));
+                ref += mt() % 10 == 0;
+            }
+        }
+        auto t1 = clock::now();
+        for (int z = -radius; z < radius; z++) {
+            for (int x = -radius; x < radius; x++) fast += isSlimeChunk(x, z);
+        }
+        auto t2 = clock::now();
+        std::vector<uint8_t> row(side);
+        for (int z = -radius; z < radius; z++) {
+            slimeChunkRow(-radius, z, side, row.data());
+            for (auto v : row) batch += v;
+        }
+        auto t3 = clock::now();
+        TextBuilder b;
+        b.textF("%zu chunks, %zu / %zu / %zu slime chunks\n", side * side, ref, fast, batch)
+            .textF(" - mt19937: %.1f ns/chunk\n", nsPerChunk(t0, t1))
+            .textF(" - fast: %.1f ns/chunk\n", nsPerChunk(t1, t2))
+            .textF(" - batch(%s): %.1f ns/chunk\n", slimeKernelName(), nsPerChunk(t2, t3));
+        return {b.get(), ref == fast && ref == batch};
+    }
+
     void setup_testCommand(int level) {
         using ParamType = DynamicCommand::ParameterType;
         // create a dynamic command
@@ -30,9 +72,19 @@ namespace trapdoor {
                                                      static_cast<CommandPermissionLevel>(level));
 
         auto &optFreeze = command->setEnum("su", {"particle"});
+        auto &optSlime = command->setEnum("slimeBench", {"slime"});
+        auto &optRotate = command->setEnum("rotateBench", {"rotate"});
         command->mandatory("test", ParamType::Enum, optFreeze,
                            CommandParameterOption::EnumAutocompleteExpansion);
+        command->mandatory("test", ParamType::Enum, optSlime,
+                           CommandParameterOption::EnumAutocompleteExpansion);
+        command->mandatory("test", ParamType::Enum, optRotate,
+                           CommandParameterOption::EnumAutocompleteExpansion);
+        command->optional("radius", ParamType::Int);
+        command->optional("rounds", ParamType::Int);
         command->addOverload({optFreeze});
+        command->addOverload({optSlime, "radius"});
+        command->addOverload({optRotate, "rounds"});
 
         auto cb = [](DynamicCommand const &command, CommandOrigin const &origin,
                      CommandOutput &output,
@@ -41,6 +93,15 @@ namespace trapdoor {
                 case do_hash("particle"):
                     test_particle(origin.getPlayer());
                     break;
+                case do_hash("slime"):
+                    test_slime(results["radius"].isSet ? results["radius"].get<int>() : 64)
+                        .sendTo(output);
+                    break;
+                case do_hash("rotate"):
+                    benchmarkBlockRotation(results["rounds"].isSet ? results["rounds"].get<int>()
+                                                                   : 10)
+                        .sendTo(output);
+                    break;
                 default:
                     break;
             }
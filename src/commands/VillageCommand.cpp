@@ -31,10 +31,18 @@ namespace trapdoor {
         command->mandatory("villageID", ParamType::Int);
         command->addOverload({optOther, "villageID"});
 
+        auto &optTimeline = command->setEnum("optTimeline", {"timeline", "export"});
+        command->mandatory("village", ParamType::Enum, optTimeline,
+                           CommandParameterOption::EnumAutocompleteExpansion);
+        command->optional("duration", ParamType::Int);
+        command->addOverload({optTimeline, "villageID", "duration"});
+
         auto cb = [](DynamicCommand const &command, CommandOrigin const &origin,
                      CommandOutput &output,
                      std::unordered_map<std::string, DynamicCommand::Result> &results) {
             auto show = results["onoroff"].getRaw<bool>();
+            // 默认一小时
+            auto duration = results["duration"].isSet ? results["duration"].getRaw<int>() : 72000;
             switch (do_hash(results["village"].getRaw<std::string>().c_str())) {
                 case do_hash("list"):
                     trapdoor::mod().getVillageHelper().listTickingVillages(true).sendTo(output);
@@ -72,6 +80,18 @@ namespace trapdoor {
                             .sendTo(output);
                     }
                     break;
+                case do_hash("timeline"):
+                    trapdoor::mod()
+                        .getVillageHelper()
+                        .printTimeline(results["villageID"].getRaw<int>(), duration)
+                        .sendTo(output);
+                    break;
+                case do_hash("export"):
+                    trapdoor::mod()
+                        .getVillageHelper()
+                        .exportTimeline(results["villageID"].getRaw<int>(), duration)
+                        .sendTo(output);
+                    break;
             }
         };
         command->setCallback(cb);
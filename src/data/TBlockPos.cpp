@@ -5,8 +5,8 @@
 #include "TBlockPos.h"
 
 #include <ostream>
-#include <random>
 
+#include "SlimeKernel.h"
 #include "TVec3.h"
 
 namespace trapdoor {
@@ -74,11 +74,7 @@ namespace trapdoor {
         return {x + pos.x, y + pos.y, z + pos.z};
     }
 
-    bool TBlockPos2::isSlimeChunk() const {
-        auto seed = (x * 0x1f1f1f1fu) ^ (uint32_t)z;
-        std::mt19937 mt(seed);
-        return mt() % 10 == 0;
-    }
+    bool TBlockPos2::isSlimeChunk() const { return trapdoor::isSlimeChunk(x, z); }
 
     bool TBlockPos2::operator<(const TBlockPos2 &rhs) const {
         if (x < rhs.x) return true;
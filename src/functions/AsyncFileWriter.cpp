@@ -0,0 +1,82 @@
+#include "AsyncFileWriter.h"
+
+#include <filesystem>
+#include <fstream>
+
+#include "TrapdoorMod.h"
+
+namespace trapdoor {
+    AsyncFileWriter::~AsyncFileWriter() {
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            this->stop = true;
+        }
+        this->cv.notify_all();
+        if (this->worker.joinable()) this->worker.join();
+    }
+
+    void AsyncFileWriter::submit(const std::string &path, std::string data) {
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            this->pending[path] = std::move(data);
+            // 第一次使用时才启动线程
+            if (!this->worker.joinable()) {
+                this->worker = std::thread(&AsyncFileWriter::work, this);
+            }
+        }
+        this->cv.notify_one();
+    }
+
+    void AsyncFileWriter::flush() {
+        std::unique_lock<std::mutex> guard(this->lock);
+        this->idle.wait(guard, [this] { return this->pending.empty() && !this->writing; });
+    }
+
+    void AsyncFileWriter::reportFailures() {
+        std::vector<std::string> failed;
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            if (this->failures.empty()) return;
+            failed.swap(this->failures);
+        }
+        for (auto &path : failed) {
+            trapdoor::logger().error("can not write file {} to disk", path);
+        }
+    }
+
+    bool AsyncFileWriter::writeAtomically(const std::string &path, const std::string &data) {
+        const auto tmp = path + ".tmp";
+        std::error_code ec;
+        auto parent = std::filesystem::path(path).parent_path();
+        if (!parent.empty()) std::filesystem::create_directories(parent, ec);
+        {
+            std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+            if (!f) return false;
+            f.write(data.data(), static_cast<std::streamsize>(data.size()));
+            if (!f) return false;
+        }
+        std::filesystem::rename(tmp, path, ec);
+        return !ec;
+    }
+
+    void AsyncFileWriter::work() {
+        std::unique_lock<std::mutex> guard(this->lock);
+        while (true) {
+            this->cv.wait(guard, [this] { return this->stop || !this->pending.empty(); });
+            // 退出前把剩下的内容写完
+            if (this->pending.empty() && this->stop) break;
+            std::unordered_map<std::string, std::string> batch;
+            batch.swap(this->pending);
+            this->writing = true;
+            guard.unlock();
+            std::vector<std::string> failed;
+            for (auto &kv : batch) {
+                if (!writeAtomically(kv.first, kv.second)) failed.push_back(kv.first);
+            }
+            guard.lock();
+            this->failures.insert(this->failures.end(), failed.begin(), failed.end());
+            this->writing = false;
+            if (this->pending.empty()) this->idle.notify_all();
+        }
+    }
+}  // namespace trapdoor
@@ -4,12 +4,16 @@
 #include <MC/Block.hpp>
 #include <MC/BlockLegacy.hpp>
 #include <MC/BlockSource.hpp>
+#include <MC/BlockTypeRegistry.hpp>
 #include <MC/ByteTag.hpp>
 #include <MC/CommandUtils.hpp>
 #include <MC/IntTag.hpp>
 #include <MC/StringTag.hpp>
+#include <chrono>
 #include <regex>
+#include <unordered_map>
 
+#include "Msg.h"
 #include "TrapdoorMod.h"
 #include "Utils.h"
 namespace trapdoor {
@@ -17,6 +21,7 @@ namespace trapdoor {
         struct RotateRule {
             std::string namePatterns;
             std::function<int(int, Vec3 const &, unsigned char)> func;
+            std::regex regex;
         };
 
         std::vector<RotateRule> &globalRotateRules() {
@@ -24,14 +29,87 @@ namespace trapdoor {
             return rules;
         }
 
+        // 没有数据值规则时按这些状态旋转，按检查顺序排列
+        enum StateRule : uint8_t {
+            PillarAxis = 1 << 0,
+            UpsideDownBit = 1 << 1,
+            WeirdoDirection = 1 << 2,
+            TopSlotBit = 1 << 3,
+            FacingDirection = 1 << 4,
+        };
+
+        // 每种方块第一次被旋转时算好的结果
+        struct RotateEntry {
+            const RotateRule *rule = nullptr;
+            uint8_t states = 0;       // 拥有的StateRule
+            bool pistonLike = false;  // 活塞和侦测器的朝向是反的
+        };
+
+        std::unordered_map<std::string, RotateEntry> &rotateEntryCache() {
+            static std::unordered_map<std::string, RotateEntry> cache;
+            return cache;
+        }
+
+        const RotateRule *findRule(const std::string &typeName) {
+            for (auto &rule : globalRotateRules()) {
+                if (std::regex_search(typeName, rule.regex)) return &rule;
+            }
+            return nullptr;
+        }
+
+        uint8_t collectStates(const Block *block) {
+            auto blockNbt = const_cast<Block *>(block)->getNbt();
+            auto *statesNbt = blockNbt->operator[]("states")->asCompoundTag();
+            auto &states = statesNbt->value();
+            uint8_t mask = 0;
+            if (states.count("pillar_axis")) mask |= PillarAxis;
+            if (states.count("upside_down_bit")) mask |= UpsideDownBit;
+            if (states.count("weirdo_direction")) mask |= WeirdoDirection;
+            if (states.count("top_slot_bit")) mask |= TopSlotBit;
+            if (states.count("facing_direction")) mask |= FacingDirection;
+            return mask;
+        }
+
+        RotateEntry resolveEntry(const Block *block, const std::string &typeName) {
+            RotateEntry entry;
+            entry.rule = findRule(typeName);
+            // 有数据值规则时用不到方块状态
+            if (!entry.rule) entry.states = collectStates(block);
+            entry.pistonLike =
+                typeName == "piston" || typeName == "observer" || typeName == "sticky_piston";
+            return entry;
+        }
+
+        const RotateEntry &rotateEntryOf(const Block *block, const std::string &typeName) {
+            auto &cache = rotateEntryCache();
+            auto it = cache.find(typeName);
+            if (it == cache.end()) {
+                it = cache.emplace(typeName, resolveEntry(block, typeName)).first;
+            }
+            return it->second;
+        }
+
+        // 这次点击实际使用的状态规则，和点击的面有关
+        uint8_t pickStateRule(uint8_t states, unsigned char face) {
+            if (states & PillarAxis) return PillarAxis;
+            if ((states & UpsideDownBit) && face < 2) return UpsideDownBit;
+            if ((states & WeirdoDirection) && face > 1) return WeirdoDirection;
+            if (states & TopSlotBit) return TopSlotBit;
+            if (states & FacingDirection) return FacingDirection;
+            return 0;
+        }
+
         bool enableRotation = false;
     }  // namespace
 
-#define ADD_RULE(pattern, func)    \
-    globalRotateRules().push_back( \
-        {#pattern, [](int v, Vec3 const &clickPos, unsigned char face) { return func; }})
+#define ADD_RULE(pattern, func)                                                         \
+    globalRotateRules().push_back(                                                      \
+        {#pattern, [](int v, Vec3 const &clickPos, unsigned char face) { return func; }, \
+         std::regex(#pattern, std::regex::optimize)})
 
     void initRotateBlockHelper() {
+        globalRotateRules().clear();
+        rotateEntryCache().clear();
         ADD_RULE(stonecutter_block, v < 4 ? 4 : v);
         ADD_RULE(bell, (v + 1) % 16);
         ADD_RULE(torch, (v + 1) % 5);
@@ -62,13 +140,9 @@ namespace trapdoor {
                                  variant, pos.toString(), clickPos.toString(),
                                  static_cast<int>(face));
 
-        auto it =
-            std::find_if(globalRotateRules().begin(), globalRotateRules().end(),
-                         [&typeName](const RotateRule &rule) {
-                             return std::regex_search(typeName, std::regex(rule.namePatterns));
-                         });
-        if (it != globalRotateRules().end()) {
-            auto newVariant = it->func(variant, clickPos, face);
+        auto &entry = rotateEntryOf(block, typeName);
+        if (entry.rule) {
+            auto newVariant = entry.rule->func(variant, clickPos, face);
             if (!bi->hasContainer()) {
                 CommandUtils::clearBlockEntityContents(*bs, pos);
                 auto *exBlock = &bs->getExtraBlock(pos);
@@ -78,46 +152,43 @@ namespace trapdoor {
             }
             bs->setBlock(pos, *Block::create(rawTypeName, newVariant), 2, nullptr, nullptr);
         } else {
+            auto stateRule = pickStateRule(entry.states, face);
+            if (!stateRule) {
+                trapdoor::logger().debug("rotateBlock: no rule for {}", typeName);
+                return true;
+            }
             auto blockNbt = block->getNbt();
             auto *statesNbt = blockNbt->operator[]("states")->asCompoundTag();
-            auto *states = &statesNbt->value();
-            bool hasRule = false;
-            if (states->find("pillar_axis") != states->end()) {
+            if (stateRule == PillarAxis) {
                 auto *tag = statesNbt->operator[]("pillar_axis")->asStringTag();
                 char axis = tag->get()[0];
                 axis -= 'x';
                 axis = (axis + 1) % 3;
                 axis += 'x';
                 statesNbt->putString("pillar_axis", std::string(1, axis));
-                hasRule = true;
-            } else if (states->find("upside_down_bit") != states->end() && face < 2) {
+            } else if (stateRule == UpsideDownBit) {
                 auto *tag = statesNbt->operator[]("upside_down_bit")->asByteTag();
                 auto bit = tag->get();
                 bit = 1 - bit;
                 statesNbt->putByte("upside_down_bit", bit);
-                hasRule = true;
-            } else if (states->find("weirdo_direction") != states->end() && face > 1) {
+            } else if (stateRule == WeirdoDirection) {
                 auto *tag = statesNbt->operator[]("weirdo_direction")->asIntTag();
                 auto direction = tag->get();
                 direction = (direction + 1) % 4;
                 statesNbt->putInt("weirdo_direction", direction);
-                hasRule = true;
-            } else if (states->find("top_slot_bit") != states->end()) {
+            } else if (stateRule == TopSlotBit) {
                 auto *tag = statesNbt->operator[]("top_slot_bit")->asByteTag();
                 auto bit = tag->get();
                 bit = 1 - bit;
                 statesNbt->putByte("top_slot_bit", bit);
-                hasRule = true;
-            } else if (states->find("facing_direction") != states->end()) {
+            } else {
                 auto *tag = statesNbt->operator[]("facing_direction")->asIntTag();
                 auto direction = tag->get();
                 auto mFace = face;
                 Vec3 mClickPos = (clickPos - pos.toVec3()) - 0.5;
                 if (abs(mClickPos.x) + abs(mClickPos.y) + abs(mClickPos.z) < 0.75) {
-                    mFace = (mFace > 1 && (typeName == "piston" || typeName == "observer" ||
-                                           typeName == "sticky_piston"))
-                                ? (mFace / 2) * 2 + (mFace + 1) % 2
-                                : mFace;
+                    mFace = (mFace > 1 && entry.pistonLike) ? (mFace / 2) * 2 + (mFace + 1) % 2
+                                                            : mFace;
                     if (direction == mFace) {
                         direction = (mFace / 2) * 2 + (mFace + 1) % 2;
                     } else {
@@ -159,32 +230,83 @@ namespace trapdoor {
                             }
                             break;
                     }
-                    direction = (direction > 1 && (typeName == "piston" || typeName == "observer" ||
-                                                   typeName == "sticky_piston"))
+                    direction = (direction > 1 && entry.pistonLike)
                                     ? (direction / 2) * 2 + (direction + 1) % 2
                                     : direction;
                 }
                 statesNbt->putInt("facing_direction", direction);
-                hasRule = true;
             }
-            if (hasRule) {
-                if (!bi->hasContainer()) {
-                    CommandUtils::clearBlockEntityContents(*bs, pos);
-                    auto *exBlock = &bs->getExtraBlock(pos);
-                    bs->setExtraBlock(pos, *BedrockBlocks::mAir, 18);
-                    bs->setBlock(pos, *BedrockBlocks::mAir, 2, nullptr, nullptr);
-                    bs->setExtraBlock(pos, *exBlock, 18);
-                }
-                bs->setBlock(pos, *Block::create(blockNbt.get()), 2, nullptr, nullptr);
-            } else {
-                trapdoor::logger().debug("rotateBlock: no rule for {}", typeName);
-                return true;
+            if (!bi->hasContainer()) {
+                CommandUtils::clearBlockEntityContents(*bs, pos);
+                auto *exBlock = &bs->getExtraBlock(pos);
+                bs->setExtraBlock(pos, *BedrockBlocks::mAir, 18);
+                bs->setBlock(pos, *BedrockBlocks::mAir, 2, nullptr, nullptr);
+                bs->setExtraBlock(pos, *exBlock, 18);
             }
+            bs->setBlock(pos, *Block::create(blockNbt.get()), 2, nullptr, nullptr);
             return true;
         }
 
         return false;
     }
+
+    ActionResult benchmarkBlockRotation(int rounds) {
+        if (rounds <= 0) rounds = 10;
+        std::vector<std::pair<std::string, const Block *>> blocks;
+        BlockTypeRegistry::forEachBlock([&blocks](BlockLegacy const &legacy) {
+            blocks.emplace_back(trapdoor::rmmc(legacy.getFullName()), &legacy.getRenderBlock());
+            return true;
+        });
+        if (blocks.empty()) return {"No block types", false};
+
+        using clock = std::chrono::steady_clock;
+        auto nsPerLookup = [&blocks, rounds](clock::time_point a, clock::time_point b) {
+            return std::chrono::duration<double, std::nano>(b - a).count() /
+                   static_cast<double>(blocks.size() * rounds);
+        };
+        // 原来的做法：每次点击对每条规则现场构造正则，没有匹配再读取方块状态
+        size_t refRules = 0, refStates = 0;
+        auto t0 = clock::now();
+        for (int r = 0; r < rounds; r++) {
+            for (auto &b : blocks) {
+                auto &rules = globalRotateRules();
+                auto it = std::find_if(rules.begin(), rules.end(), [&b](const RotateRule &rule) {
+                    return std::regex_search(b.first, std::regex(rule.namePatterns));
+                });
+                if (it != rules.end()) {
+                    refRules++;
+                } else if (collectStates(b.second)) {
+                    refStates++;
+                }
+            }
+        }
+        auto t1 = clock::now();
+        std::unordered_map<std::string, RotateEntry> cache;
+        for (auto &b : blocks) cache.emplace(b.first, resolveEntry(b.second, b.first));
+        auto t2 = clock::now();
+        size_t rules = 0, states = 0;
+        for (int r = 0; r < rounds; r++) {
+            for (auto &b : blocks) {
+                auto &entry = cache.find(b.first)->second;
+                if (entry.rule) {
+                    rules++;
+                } else if (entry.states) {
+                    states++;
+                }
+            }
+        }
+        auto t3 = clock::now();
+
+        TextBuilder builder;
+        builder
+            .textF("%zu block types, %zu with data rules, %zu with state rules\n", blocks.size(),
+                   rules / rounds, states / rounds)
+            .textF(" - regex per click: %.1f ns/block\n", nsPerLookup(t0, t1))
+            .textF(" - build table: %.1f ns/block\n", nsPerLookup(t1, t2) * rounds)
+            .textF(" - table lookup: %.1f ns/block\n", nsPerLookup(t2, t3));
+        return {builder.get(), refRules == rules && refStates == states};
+    }
+
     ActionResult setBlockRotationAble(bool able) {
         enableRotation = able;
         return {"Success", true};
@@ -0,0 +1,133 @@
+#include "EntityIndex.h"
+
+#include <MC/Actor.hpp>
+#include <MC/Level.hpp>
+#include <cmath>
+
+namespace trapdoor {
+    uint16_t EntityIndex::internType(const std::string &name) {
+        auto it = this->typeIds.find(name);
+        if (it != this->typeIds.end()) return it->second;
+        auto id = static_cast<uint16_t>(this->typeNames.size());
+        this->typeNames.push_back(name);
+        this->typeIds.emplace(name, id);
+        return id;
+    }
+
+    void EntityIndex::link(const Entry &entry) {
+        auto &bucket = this->buckets[entry.dim][entry.chunk];
+        if (bucket.counts.size() <= entry.slot) bucket.counts.resize(entry.slot + 1, 0);
+        ++bucket.counts[entry.slot];
+        ++bucket.total;
+        auto &total = this->totals[entry.dim];
+        if (total.size() <= entry.slot) total.resize(entry.slot + 1, 0);
+        ++total[entry.slot];
+    }
+
+    void EntityIndex::unlink(const Entry &entry) {
+        auto &chunks = this->buckets[entry.dim];
+        auto it = chunks.find(entry.chunk);
+        if (it != chunks.end()) {
+            --it->second.counts[entry.slot];
+            if (--it->second.total == 0) chunks.erase(it);
+        }
+        --this->totals[entry.dim][entry.slot];
+    }
+
+    void EntityIndex::tick() {
+        ++this->currentTick;
+        if (this->active && this->currentTick - this->lastUse > IDLE_TIMEOUT) {
+            this->active = false;
+            this->clear();
+        }
+    }
+
+    void EntityIndex::use() {
+        this->lastUse = this->currentTick;
+        if (this->active) return;
+        this->active = true;
+        this->clear();
+        for (auto *actor : Level::getAllEntities()) {
+            if (actor) this->update(actor);
+        }
+    }
+
+    // 只有新实体才需要取类型名，其余情况只是一次哈希查找
+    void EntityIndex::update(Actor *actor) {
+        auto pos = actor->getPos();
+        auto cx = static_cast<int>(std::floor(pos.x)) >> 4;
+        auto cz = static_cast<int>(std::floor(pos.z)) >> 4;
+        auto dim = static_cast<int>(actor->getDimensionId());
+        auto uid = actor->getUniqueID().id;
+        if (!this->touch(actor, uid, dim, cx, cz)) {
+            this->insert(actor, uid, dim, cx, cz, this->internType(actor->getTypeName()),
+                         actor->isSurfaceMob());
+        }
+    }
+
+    bool EntityIndex::touch(const void *actor, int64_t uid, int dim, int cx, int cz) {
+        auto it = this->entries.find(actor);
+        if (it == this->entries.end()) return false;
+        auto &entry = it->second;
+        if (entry.uid != uid) {
+            this->unlink(entry);
+            this->entries.erase(it);
+            return false;
+        }
+        auto key = chunkKey(cx, cz);
+        if (entry.chunk == key && entry.dim == dim) return true;
+        if (dim < 0 || dim >= DIMENSION_NUM) {
+            this->unlink(entry);
+            this->entries.erase(it);
+            return true;
+        }
+        this->unlink(entry);
+        entry.dim = dim;
+        entry.chunk = key;
+        this->link(entry);
+        return true;
+    }
+
+    void EntityIndex::insert(const void *actor, int64_t uid, int dim, int cx, int cz,
+                             uint16_t type, bool surface) {
+        if (dim < 0 || dim >= DIMENSION_NUM) return;
+        Entry entry{dim, chunkKey(cx, cz), (static_cast<uint32_t>(type) << 1) | (surface ? 1 : 0),
+                    uid};
+        auto res = this->entries.emplace(actor, entry);
+        if (!res.second) {
+            this->unlink(res.first->second);
+            res.first->second = entry;
+        }
+        this->link(entry);
+    }
+
+    void EntityIndex::remove(const void *actor) {
+        auto it = this->entries.find(actor);
+        if (it == this->entries.end()) return;
+        this->unlink(it->second);
+        this->entries.erase(it);
+    }
+
+    void EntityIndex::clear() {
+        this->entries.clear();
+        for (auto &chunks : this->buckets) chunks.clear();
+        for (auto &total : this->totals) total.clear();
+    }
+
+    std::vector<size_t> EntityIndex::countInRange(int dim, int cx, int cz, int r) const {
+        std::vector<size_t> res(this->typeNames.size(), 0);
+        this->forEachInRange(dim, cx, cz, r,
+                             [&res](uint16_t type, bool, uint32_t count) { res[type] += count; });
+        return res;
+    }
+
+    std::vector<size_t> EntityIndex::countAll(int dim) const {
+        std::vector<size_t> res(this->typeNames.size(), 0);
+        if (dim < 0 || dim >= DIMENSION_NUM) return res;
+        auto &total = this->totals[dim];
+        for (size_t slot = 0; slot < total.size(); slot++) {
+            res[slot >> 1] += total[slot];
+        }
+        return res;
+    }
+}  // namespace trapdoor
@@ -63,14 +63,13 @@ namespace trapdoor {
             shortcut.type = USE;
             shortcut.itemAux = ev.mItemStack->getAux();
             shortcut.itemName = trapdoor::rmmc(ev.mItemStack->getTypeName());
-            for (auto& sh : shortcuts) {
-                if (sh.match(shortcut)) {
-                    sh.runUse(ev.mPlayer, ev.mItemStack);
-                    return !sh.prevent;
-                }
+            auto index = trapdoor::mod().getConfig().getShortcutIndex().find(shortcut);
+            if (index < 0) {
+                return true;
             }
-
-            return true;
+            auto& sh = shortcuts[index];
+            sh.runUse(ev.mPlayer, ev.mItemStack);
+            return !sh.prevent;
         });
     }
 
@@ -98,16 +97,13 @@ namespace trapdoor {
             shortcut.itemName = trapdoor::rmmc(ev.mItemStack->getTypeName());
             shortcut.blockAux = block->getVariant();
             shortcut.blockName = trapdoor::rmmc(block->getName().getString());
-            for (auto sh : shortcuts) {
-                if (sh.match(shortcut)) {
-                    if (antiShake(ev.mPlayer->getRealName(), bi->getPosition())) {
-                        sh.runUseOn(ev.mPlayer, ev.mItemStack, block, bi->getPosition());
-                        return !sh.prevent;
-                    }
-                }
+            auto index = trapdoor::mod().getConfig().getShortcutIndex().find(shortcut);
+            if (index < 0 || !antiShake(ev.mPlayer->getRealName(), bi->getPosition())) {
+                return true;
             }
-
-            return true;
+            auto& sh = shortcuts[index];
+            sh.runUseOn(ev.mPlayer, ev.mItemStack, block, bi->getPosition());
+            return !sh.prevent;
         });
     }
 
@@ -124,6 +120,10 @@ namespace trapdoor {
             if (bi->isNull()) {
                 return true;
             }
+            auto& shortcuts = trapdoor::mod().getConfig().getShortcuts();
+            if (shortcuts.empty()) {
+                return true;
+            }
             auto* block = bi->getBlock();
             Shortcut shortcut;
             shortcut.type = DESTROY;
@@ -132,16 +132,13 @@ namespace trapdoor {
 
             shortcut.blockAux = block->getVariant();
             shortcut.blockName = trapdoor::rmmc(block->getName().getString());
-            auto& shortcuts = trapdoor::mod().getConfig().getShortcuts();
-            for (auto& sh : shortcuts) {
-                if (sh.match(shortcut)) {
-                    sh.runUseDestroy(ev.mPlayer, &ev.mPlayer->getSelectedItem(), block,
-                                     bi->getPosition());
-                    return !sh.prevent;
-                }
+            auto index = trapdoor::mod().getConfig().getShortcutIndex().find(shortcut);
+            if (index < 0) {
+                return true;
             }
-
-            return true;
+            auto& sh = shortcuts[index];
+            sh.runUseDestroy(ev.mPlayer, &ev.mPlayer->getSelectedItem(), block, bi->getPosition());
+            return !sh.prevent;
         });
 
         Event::PlayerStartDestroyBlockEvent::subscribe(
@@ -154,11 +151,19 @@ namespace trapdoor {
     void subscribePlayerInventoryChangeEvent() {
         Event::PlayerInventoryChangeEvent::subscribe(
             [&](const Event::PlayerInventoryChangeEvent& ev) {
+                trapdoor::mod().getInventoryIndex().onSlotChanged(ev.mPlayer, ev.mSlot);
                 trapdoor::mod().getSimPlayerManager().tryRefreshInv(ev.mPlayer);
                 return true;
             });
     }
 
+    void subscribePlayerLeftEvent() {
+        Event::PlayerLeftEvent::subscribe([&](const Event::PlayerLeftEvent& ev) {
+            trapdoor::mod().getInventoryIndex().remove(ev.mPlayer);
+            return true;
+        });
+    }
+
     void subscribeServerStartEvent() {
         Event::ServerStartedEvent::subscribe([&](const Event::ServerStartedEvent& ev) {
             trapdoor::mod().getSimPlayerManager().addPlayersInCache();
@@ -74,10 +74,16 @@ namespace trapdoor {
             }
             auto& biome = bs.getBiome(pos);
             b.textF("Biome: %s (%d)\n", getBiomeName(&biome).c_str(), biome.getBiomeType());
+            if (!pointBlock.isNull()) {
+                auto* hsa = trapdoor::mod().getHsaManager().find(
+                    static_cast<int>(player->getDimensionId()),
+                    fromBlockPos(pointPos + BlockPos(0, 1, 0)));
+                if (hsa) b.textF("HSA: %s\n", structureName(hsa->type));
+            }
             return b.get();
         }
 
-        std::string buildMsptHud() {
+        std::string buildMsptHud(Player*) {
             TextBuilder builder;
             auto mspt = trapdoor::getMeanMSPT();
             auto tps = 1000.0 / mspt;
@@ -91,13 +97,60 @@ namespace trapdoor {
             return builder.get();
         }
 
+        std::string buildVillageHud(Player* player) {
+            if (static_cast<int>(player->getDimensionId()) != 0) return "";
+            auto& helper = trapdoor::mod().getVillageHelper();
+            auto& index = helper.getIndex();
+            auto pos = fromVec3(player->getPos());
+            float dis = 0;
+            auto vid = index.containing(pos);
+            bool inside = vid != -1;
+            if (!inside) vid = index.nearest(pos, &dis);
+            auto it = helper.getVillages().find(vid);
+            if (it == helper.getVillages().end()) return "Village: -\n";
+
+            const auto& info = it->second;
+            TextBuilder b;
+            b.textF("Village: [%d] p:%zu g:%zu b:%zu", vid, info.dwellerCount[0],
+                    info.dwellerCount[1], info.bedCount);
+            if (!inside) b.textF(" (%.1fm)", dis);
+            b.text("\n");
+
+            auto pointBlock = reinterpret_cast<Actor*>(player)->getBlockFromViewVector();
+            if (!pointBlock.isNull()) {
+                const char* names[3] = {"Bed", "Alarm", "Work"};
+                int poiVid = -1;
+                auto* poi = index.poiAt(fromBlockPos(pointBlock.getPosition()), &poiVid);
+                if (poi) b.textF("POI: %s [%d]\n", names[poi->type], poiVid);
+            }
+            return b.get();
+        }
+
+        std::string buildCapHud(Player* player) {
+            return trapdoor::mod().getMobCapMonitor().getHUDText(
+                static_cast<int>(player->getDimensionId()));
+        }
+
+        // 数组顺序即HUD中的显示顺序
+        constexpr HUDSection HUD_SECTIONS[] = {
+            {"base", HUDInfoType::Base, 1, HUDCost::Cheap, buildBaseHud},
+            {"mspt", HUDInfoType::Mspt, 1, HUDCost::Cheap, buildMsptHud},
+            {"redstone", HUDInfoType::Redstone, 1, HUDCost::Normal, buildRedstoneInfo},
+            {"village", HUDInfoType::Vill, 1, HUDCost::Normal, buildVillageHud},
+            {"hopper", HUDInfoType::Counter, 1, HUDCost::Normal, buildHopperCounter},
+            {"chunk", HUDInfoType::Chunk, 1, HUDCost::Cheap, nullptr},
+            {"cap", HUDInfoType::Cap, 1, HUDCost::Cheap, buildCapHud},
+        };
+
+        static_assert(sizeof(HUD_SECTIONS) / sizeof(HUDSection) == HUDInfoType::Unknown,
+                      "every HUDInfoType needs a section");
+
+        constexpr uint32_t bit(HUDInfoType type) { return 1u << static_cast<uint32_t>(type); }
+
         HUDInfoType getTypeFromString(const std::string& str) {
-            if (str == "base") return HUDInfoType::Base;
-            if (str == "hopper") return HUDInfoType::Counter;
-            if (str == "village") return HUDInfoType::Vill;
-            if (str == "redstone") return HUDInfoType::Redstone;
-            if (str == "mspt") return HUDInfoType::Mspt;
-            if (str == "chunk") return HUDInfoType::Chunk;
+            for (const auto& sec : HUD_SECTIONS) {
+                if (str == sec.name) return sec.type;
+            }
             return HUDInfoType::Unknown;
         }
 
@@ -107,8 +160,9 @@ namespace trapdoor {
         refresh_time = (refresh_time + 1) % 15;
         if (refresh_time != 1) return;
         for (auto& info : this->playerInfos) {
+            if (!info.second.enable || !(info.second.mask & bit(HUDInfoType::Chunk))) continue;
             auto* p = Global<Level>->getPlayer(info.first);
-            if (p && info.second.enable && info.second.config[HUDInfoType::Chunk]) {
+            if (p) {
                 auto pos = p->getPos().toBlockPos();
                 trapdoor::drawChunkSurface(fromBlockPos(pos).toChunkPos(),
                                            (int)p->getDimension().getDimensionId());
@@ -122,28 +176,27 @@ namespace trapdoor {
         refresh_time =
             (refresh_time + 1) % trapdoor::mod().getConfig().getBasicConfig().hudRefreshFreq;
         if (refresh_time != 1) return;
+        ++this->round;
+        // 卡顿时Normal栏目刷新间隔翻倍，Heavy栏目翻四倍
+        const bool lagging = trapdoor::getMeanMSPT() > 50.0;
         for (auto& info : this->playerInfos) {
+            auto& hud = info.second;
+            if (!hud.enable || hud.mask == 0) continue;
             auto* p = Global<Level>->getPlayer(info.first);
-            if (p && info.second.enable) {
-                std::string s;
-                auto& cfg = info.second.config;
-                if (cfg[HUDInfoType::Base]) {
-                    s += buildBaseHud(p);
-                }
-                if (cfg[HUDInfoType::Mspt]) {
-                    s += buildMsptHud();
-                }
-                if (cfg[HUDInfoType::Redstone]) {
-                    s += buildRedstoneInfo(p);
+            if (!p) continue;
+            std::string s;
+            for (const auto& sec : HUD_SECTIONS) {
+                if (!sec.build || !(hud.mask & bit(sec.type))) continue;
+                auto interval = static_cast<size_t>(sec.interval)
+                                << (lagging ? static_cast<int>(sec.cost) : 0);
+                auto& last = hud.lastRefresh[sec.type];
+                if (last == 0 || this->round - last >= interval) {
+                    hud.cache[sec.type] = sec.build(p);
+                    last = this->round;
                 }
-                if (cfg[HUDInfoType::Vill]) {
-                    s += "Village: Developing\n";
-                }
-                if (cfg[HUDInfoType::Counter]) {
-                    s += buildHopperCounter(p);
-                }
-                p->sendText(s, TextType::TIP);
+                s += hud.cache[sec.type];
             }
+            p->sendText(s, TextType::TIP);
         }
     }
 
@@ -153,10 +206,25 @@ namespace trapdoor {
         if (type == HUDInfoType::Unknown) {
             return {"Unknown type", false};
         }
-        this->playerInfos[playerName].config[type] = op;
+        auto& hud = this->playerInfos[playerName];
+        if (op) {
+            hud.mask |= bit(type);
+            hud.lastRefresh[type] = 0;
+        } else {
+            hud.mask &= ~bit(type);
+            hud.cache[type].clear();
+        }
         return {"Success", true};
     }
 
+    std::vector<std::string> HUDHelper::getSectionNames() {
+        std::vector<std::string> names;
+        for (const auto& sec : HUD_SECTIONS) {
+            names.emplace_back(sec.name);
+        }
+        return names;
+    }
+
     ActionResult HUDHelper::setAblePlayer(const std::string& playerName, bool able) {
         if (!this->enable) {
             return {"This function is disabled by Operator", false};
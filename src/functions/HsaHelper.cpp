@@ -2,9 +2,17 @@
 
 #include <MC/Biome.hpp>
 #include <MC/BlockSource.hpp>
+#include <MC/ChunkPos.hpp>
+#include <MC/Level.hpp>
+#include <MC/LevelChunk.hpp>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 
+#include "DataConverter.h"
 #include "HookAPI.h"
 #include "Particle.h"
+#include "TrapdoorMod.h"
 
 namespace trapdoor {
     namespace {
@@ -15,38 +23,320 @@ namespace trapdoor {
             TVec3 maxPoint{x + 1, aabb.maxPos.y + 1, z};
             return {minPoint, maxPoint};
         }
+
+        constexpr uint32_t HSA_FILE_MAGIC = 0x41534854;  // "THSA"
+        constexpr uint32_t HSA_FILE_VERSION = 1;
+
+        inline uint64_t chunkKey(int cx, int cz) {
+            return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) |
+                   static_cast<uint32_t>(cz);
+        }
+
+        // LevelChunk::HardcodedSpawningArea的内存布局
+        struct THardcodedSpawningArea {
+            TBoundingBox bb;
+            uint8_t type;
+        };
+
+        const std::vector<THardcodedSpawningArea> &getSpawningAreas(LevelChunk *chunk) {
+            return SymCall(
+                "?getSpawningAreas@LevelChunk@@QEBAAEBV?$vector@UHardcodedSpawningArea@"
+                "LevelChunk@@V?$allocator@UHardcodedSpawningArea@LevelChunk@@@std@@@std@@XZ",
+                const std::vector<THardcodedSpawningArea> &, LevelChunk *)(chunk);
+        }
+
+        // 类型字节不认识时的兜底：下界只有要塞，主世界按生物群系区分
+        StructureType guessStructureType(const BlockSource &bs, const BlockPos &pos, int dim) {
+            if (dim == 1) return NetherFortress;
+            auto biome = bs.tryGetBiome(pos);
+            if (biome) {
+                auto type = static_cast<int>(biome->getBiomeType());
+                if (type == 10) return OceanMonument;
+                if (type == 15) return SwampHut;
+            }
+            return PillagerOutpost;
+        }
+
+        // LevelChunk::HardcodedSpawnAreaType：1要塞 2女巫小屋 3海底神殿 5掠夺者前哨站
+        StructureType structureTypeOf(const THardcodedSpawningArea &area, const BlockSource &bs,
+                                      int dim) {
+            switch (area.type) {
+                case 1:
+                    return NetherFortress;
+                case 2:
+                    return SwampHut;
+                case 3:
+                    return OceanMonument;
+                case 5:
+                    return PillagerOutpost;
+                default: {
+                    auto &p = area.bb.minPos;
+                    return guessStructureType(bs, BlockPos(p.x, p.y, p.z), dim);
+                }
+            }
+        }
     }  // namespace
 
     bool HsaInfo::operator<(const HsaInfo &rhs) const { return bb < rhs.bb; }
 
-    ActionResult HsaManager::place() { return {"", true}; }
+    bool HsaInfo::operator==(const HsaInfo &rhs) const {
+        return dimensionID == rhs.dimensionID && !(bb < rhs.bb) && !(rhs.bb < bb);
+    }
+
+    const char *structureName(StructureType type) {
+        switch (type) {
+            case SwampHut:
+                return "SwampHut";
+            case OceanMonument:
+                return "OceanMonument";
+            case PillagerOutpost:
+                return "PillagerOutpost";
+            case NetherFortress:
+                return "NetherFortress";
+        }
+        return "Unknown";
+    }
+
+    void HsaManager::insert(const HsaInfo &info) {
+        if (info.dimensionID < 0 || info.dimensionID > 2) return;
+        auto &cells = this->cells[info.dimensionID];
+        // 同一个HSA必然挂在它的最小角所在的区块上，只需要在这个桶里查重
+        auto first = cells.find(chunkKey(info.bb.minPos.x >> 4, info.bb.minPos.z >> 4));
+        if (first != cells.end()) {
+            for (auto idx : first->second) {
+                if (this->hsaList[idx] == info) return;
+            }
+        }
+        auto idx = static_cast<uint32_t>(this->hsaList.size());
+        this->hsaList.push_back(info);
+        for (int cx = info.bb.minPos.x >> 4; cx <= info.bb.maxPos.x >> 4; cx++) {
+            for (int cz = info.bb.minPos.z >> 4; cz <= info.bb.maxPos.z >> 4; cz++) {
+                cells[chunkKey(cx, cz)].push_back(idx);
+            }
+        }
+        this->dirty = true;
+    }
+
+    const HsaInfo *HsaManager::find(int dim, const TBlockPos &pos) const {
+        if (dim < 0 || dim > 2) return nullptr;
+        auto &cells = this->cells[dim];
+        auto it = cells.find(chunkKey(pos.x >> 4, pos.z >> 4));
+        if (it == cells.end()) return nullptr;
+        for (auto idx : it->second) {
+            auto &bb = this->hsaList[idx].bb;
+            if (pos.x >= bb.minPos.x && pos.x <= bb.maxPos.x && pos.y >= bb.minPos.y &&
+                pos.y <= bb.maxPos.y && pos.z >= bb.minPos.z && pos.z <= bb.maxPos.z) {
+                return &this->hsaList[idx];
+            }
+        }
+        return nullptr;
+    }
+
+    ActionResult HsaManager::clear() {
+        auto num = this->hsaList.size();
+        this->hsaList.clear();
+        for (auto &c : this->cells) c.clear();
+        for (auto &c : this->scannedChunks) c.clear();
+        this->drawQueue.clear();
+        this->dirty = true;
+        return {std::to_string(num), true};
+    }
+
+    // 文件格式: magic(4) version(4) count(4) 然后每条记录 dim(1) type(1) 六个int32
+    void HsaManager::load(const std::string &path) {
+        this->filePath = path;
+        std::ifstream f(path, std::ios::binary);
+        if (!f) return;
+        uint32_t magic = 0, version = 0, count = 0;
+        f.read(reinterpret_cast<char *>(&magic), 4);
+        f.read(reinterpret_cast<char *>(&version), 4);
+        f.read(reinterpret_cast<char *>(&count), 4);
+        if (!f || magic != HSA_FILE_MAGIC || version != HSA_FILE_VERSION) {
+            trapdoor::logger().warn("Invalid hsa file {}", path);
+            return;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            int8_t head[2];
+            int32_t v[6];
+            f.read(reinterpret_cast<char *>(head), sizeof(head));
+            f.read(reinterpret_cast<char *>(v), sizeof(v));
+            if (!f) break;
+            HsaInfo info;
+            info.dimensionID = head[0];
+            info.type = static_cast<StructureType>(head[1]);
+            info.bb.minPos = {v[0], v[1], v[2]};
+            info.bb.maxPos = {v[3], v[4], v[5]};
+            this->insert(info);
+        }
+        this->dirty = false;
+        trapdoor::logger().debug("Load {} hsa from {}", this->hsaList.size(), path);
+    }
+
+    // 交给后台线程写，先写临时文件再重命名，写到一半崩溃也不会损坏原来的文件
+    void HsaManager::save() {
+        if (this->filePath.empty()) return;
+        std::string data;
+        uint32_t header[3] = {HSA_FILE_MAGIC, HSA_FILE_VERSION,
+                              static_cast<uint32_t>(this->hsaList.size())};
+        data.append(reinterpret_cast<const char *>(header), sizeof(header));
+        for (auto &info : this->hsaList) {
+            int8_t head[2] = {static_cast<int8_t>(info.dimensionID),
+                              static_cast<int8_t>(info.type)};
+            int32_t v[6] = {info.bb.minPos.x, info.bb.minPos.y, info.bb.minPos.z,
+                            info.bb.maxPos.x, info.bb.maxPos.y, info.bb.maxPos.z};
+            data.append(reinterpret_cast<const char *>(head), sizeof(head));
+            data.append(reinterpret_cast<const char *>(v), sizeof(v));
+        }
+        this->writer.submit(this->filePath, std::move(data));
+        this->dirty = false;
+    }
+
+    // 只记住玩家附近扫描过的区块，离开所有玩家扫描范围的区块会被忘掉，回来时重新扫描(insert会去重)
+    void HsaManager::pruneScanned() {
+        std::array<std::unordered_set<uint64_t>, 3> nearby;
+        Global<Level>->forEachPlayer([&](Player &player) {
+            auto dim = static_cast<int>(player.getDimensionId());
+            if (dim < 0 || dim > 2) return true;
+            auto center = fromBlockPos(player.getPos().toBlockPos()).toChunkPos();
+            for (int cx = center.x - SCAN_RADIUS; cx <= center.x + SCAN_RADIUS; cx++) {
+                for (int cz = center.z - SCAN_RADIUS; cz <= center.z + SCAN_RADIUS; cz++) {
+                    nearby[dim].insert(chunkKey(cx, cz));
+                }
+            }
+            return true;
+        });
+        for (int dim = 0; dim < 3; dim++) {
+            auto &scanned = this->scannedChunks[dim];
+            for (auto it = scanned.begin(); it != scanned.end();) {
+                if (nearby[dim].count(*it)) {
+                    ++it;
+                } else {
+                    it = scanned.erase(it);
+                }
+            }
+        }
+    }
+
+    void HsaManager::scanLoadedChunks() {
+        this->pruneScanned();
+        size_t budget = SCAN_CHUNKS_PER_ROUND;
+        Global<Level>->forEachPlayer([&](Player &player) {
+            if (budget == 0) return false;
+            auto dim = static_cast<int>(player.getDimensionId());
+            if (dim < 0 || dim > 2) return true;
+            auto &bs = player.getRegion();
+            auto &scanned = this->scannedChunks[dim];
+            auto center = fromBlockPos(player.getPos().toBlockPos()).toChunkPos();
+            for (int cx = center.x - SCAN_RADIUS; cx <= center.x + SCAN_RADIUS; cx++) {
+                for (int cz = center.z - SCAN_RADIUS; cz <= center.z + SCAN_RADIUS; cz++) {
+                    auto key = chunkKey(cx, cz);
+                    if (scanned.count(key)) continue;
+                    auto *chunk = bs.getChunk(ChunkPos(cx, cz));
+                    if (!chunk || !chunk->isFullyLoaded()) continue;
+                    scanned.insert(key);
+                    for (auto &area : getSpawningAreas(chunk)) {
+                        HsaInfo info;
+                        info.dimensionID = dim;
+                        info.bb = area.bb;
+                        info.type = structureTypeOf(area, bs, dim);
+                        this->insert(info);
+                    }
+                    if (--budget == 0) return false;
+                }
+            }
+            return true;
+        });
+    }
 
     void HsaManager::HeavyTick() {
+        static int scan_time = 0;
+        scan_time = (scan_time + 1) % 200;
+        if (scan_time == 1) {
+            this->scanLoadedChunks();
+            if (this->dirty) this->save();
+            this->writer.reportFailures();
+        }
+
         if (!this->showHsa) return;
-        static int gt = 0;
-        if (gt % 40 == 0) {
-            auto color = PCOLOR::WHITE;
-            for (const auto &hsa : this->hsaList) {
-                switch (hsa.type) {
-                    case PillagerOutpost:
-                        color = PCOLOR::BLUE;
-                        break;
-                    case SwampHut:
-                        color = PCOLOR::RED;
-                        break;
-                    case NetherFortress:
-                        color = PCOLOR::GREEN;
-                        break;
-                    case OceanMonument:
-                        color = PCOLOR::YELLOW;
-                        break;
-                    default:
-                        break;
+        // 上一轮画完并且过了40gt才重新收集，看得见的HSA再多也都能轮到
+        static int refresh_time = 40;
+        if (refresh_time < 40) ++refresh_time;
+        if (refresh_time >= 40 && this->drawQueue.empty()) {
+            refresh_time = 0;
+            this->collectVisible();
+        }
+        this->drawQueued();
+    }
+
+    // 只从每个玩家视距内的区块桶里取HSA，多个玩家看到的同一个HSA只画一次
+    // 按到最近玩家的距离排序，先画近处的
+    void HsaManager::collectVisible() {
+        this->drawQueue.clear();
+        auto pvd2 = trapdoor::mod().getConfig().getBasicConfig().particleViewDistance2D;
+        auto radius = static_cast<int>(std::sqrt(static_cast<double>(pvd2))) / 16 + 1;
+        std::vector<std::pair<uint32_t, float>> visible;  // (下标, 距离的平方)
+        Global<Level>->forEachPlayer([&](Player &player) {
+            auto dim = static_cast<int>(player.getDimensionId());
+            if (dim < 0 || dim > 2) return true;
+            auto &cells = this->cells[dim];
+            if (cells.empty()) return true;
+            auto pos = player.getPos();
+            auto center = fromBlockPos(pos.toBlockPos()).toChunkPos();
+            for (int cx = center.x - radius; cx <= center.x + radius; cx++) {
+                for (int cz = center.z - radius; cz <= center.z + radius; cz++) {
+                    auto it = cells.find(chunkKey(cx, cz));
+                    if (it == cells.end()) continue;
+                    for (auto idx : it->second) {
+                        auto &bb = this->hsaList[idx].bb;
+                        auto dx = (bb.minPos.x + bb.maxPos.x) * 0.5f - pos.x;
+                        auto dz = (bb.minPos.z + bb.maxPos.z) * 0.5f - pos.z;
+                        auto d2 = dx * dx + dz * dz;
+                        if (d2 <= static_cast<float>(pvd2)) visible.emplace_back(idx, d2);
+                    }
                 }
-                trapdoor::drawAABB(getSpawnAreaFromHSA(hsa.bb), color, true, hsa.dimensionID);
             }
+            return true;
+        });
+        // 同一个HSA只保留最近的距离
+        std::sort(visible.begin(), visible.end());
+        visible.erase(std::unique(visible.begin(), visible.end(),
+                                  [](const std::pair<uint32_t, float> &a,
+                                     const std::pair<uint32_t, float> &b) {
+                                      return a.first == b.first;
+                                  }),
+                      visible.end());
+        std::sort(visible.begin(), visible.end(),
+                  [](const std::pair<uint32_t, float> &a, const std::pair<uint32_t, float> &b) {
+                      return a.second < b.second;
+                  });
+        for (auto &v : visible) this->drawQueue.push_back(v.first);
+    }
+
+    void HsaManager::drawQueued() {
+        for (size_t i = 0; i < MAX_BOXES_PER_TICK && !this->drawQueue.empty(); i++) {
+            auto idx = this->drawQueue.front();
+            this->drawQueue.pop_front();
+            if (idx >= this->hsaList.size()) continue;
+            const auto &hsa = this->hsaList[idx];
+            auto color = PCOLOR::WHITE;
+            switch (hsa.type) {
+                case PillagerOutpost:
+                    color = PCOLOR::BLUE;
+                    break;
+                case SwampHut:
+                    color = PCOLOR::RED;
+                    break;
+                case NetherFortress:
+                    color = PCOLOR::GREEN;
+                    break;
+                case OceanMonument:
+                    color = PCOLOR::YELLOW;
+                    break;
+                default:
+                    break;
+            }
+            trapdoor::drawAABB(getSpawnAreaFromHSA(hsa.bb), color, true, hsa.dimensionID);
         }
-        gt = (gt + 1) % 80;
     }
 
 }  // namespace trapdoor
@@ -55,27 +345,12 @@ THook(void,
       "?_spawnStructureMob@Spawner@@AEAAXAEAVBlockSource@@AEBVBlockPos@@"
       "AEBUHardcodedSpawningArea@LevelChunk@@AEBVSpawnConditions@@@Z",
       void *spawner, const BlockSource &bs, const BlockPos &blockPos,
-      const trapdoor::TBoundingBox &hsa, void *spawnConditions) {
+      const trapdoor::THardcodedSpawningArea &hsa, void *spawnConditions) {
     original(spawner, bs, blockPos, hsa, spawnConditions);
     auto &hsaManager = trapdoor::mod().getHsaManager();
     trapdoor::HsaInfo info;
     info.dimensionID = bs.getDimensionId();
-    info.bb = hsa;
-    if (info.dimensionID == 1) {
-        info.type = trapdoor::NetherFortress;
-    } else {
-        auto biome = bs.tryGetBiome(blockPos);
-        if (biome) {
-            auto type = static_cast<int>(biome->getBiomeType());
-            if (type == 10) {
-                info.type = trapdoor::OceanMonument;
-            } else if (type == 15) {
-                info.type = trapdoor::SwampHut;
-            } else {
-                info.type = trapdoor::PillagerOutpost;
-            }
-        }
-    }
-
+    info.bb = hsa.bb;
+    info.type = trapdoor::structureTypeOf(hsa, bs, info.dimensionID);
     hsaManager.insert(info);
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include <MC/Inventory.hpp>
 #include <MC/ItemStack.hpp>
 #include <MC/Material.hpp>
+#include <algorithm>
 #include <cstdio>
 
 #include "Config.h"
@@ -17,32 +18,138 @@
 namespace trapdoor {
     namespace {
 
-        struct ToolInfo {
-            float speed;
-            int slot;
-            short remainDamage;
-        };
+        constexpr short MIN_TOOL_REMAIN_DAMAGE = 5;
 
-        int searchBestToolInInv(Container &inv, int currentSlot, const Block *b) {
+        inline int itemIdOf(const ItemStack *item) {
+            return item && item->getCount() != 0 ? item->getId() : 0;
+        }
+
+        // 耐久快用完的工具不参与自动选择
+        inline bool usableTool(ItemStack *item) {
+            return item && item->getCount() != 0 &&
+                   item->getMaxDamage() - item->getDamageValue() > MIN_TOOL_REMAIN_DAMAGE;
+        }
+
+        void eraseSlot(std::vector<int> &slots, int slot) {
+            auto it = std::lower_bound(slots.begin(), slots.end(), slot);
+            if (it != slots.end() && *it == slot) slots.erase(it);
+        }
+
+        void insertSlot(std::vector<int> &slots, int slot) {
+            auto it = std::lower_bound(slots.begin(), slots.end(), slot);
+            if (it == slots.end() || *it != slot) slots.insert(it, slot);
+        }
+
+        // 当前格子优先，只有别的格子严格更快时才换
+        int searchBestToolInInv(Player *player, int currentSlot, const Block *b) {
+            auto &inv = player->getInventory();
             auto curItem = inv.getSlot(currentSlot);
-            ToolInfo curInfo{curItem->getDestroySpeed(*b), currentSlot,
-                             (short)(curItem->getMaxDamage() - curItem->getDamageValue())};
-            auto sz = inv.getSize();
-            for (int i = 0; i < sz; i++) {
-                auto *item = inv.getSlot(i);
-                if (item && item->getCount() != 0) {
-                    auto speed = item->getDestroySpeed(*b);
-                    auto remainDamage = item->getMaxDamage() - item->getDamageValue();
-                    if (remainDamage <= 5) continue;
-                    if (speed > curInfo.speed) {
-                        curInfo = {speed, i, (short)remainDamage};
-                    }
+            auto curSpeed = curItem->getDestroySpeed(*b);
+            auto best = trapdoor::mod().getInventoryIndex().bestTool(player, b);
+            return best.second >= 0 && best.first > curSpeed ? best.second : currentSlot;
+        }
+    }  // namespace
+
+    InventoryIndex::Entry &InventoryIndex::get(Player *player) {
+        auto &entry = this->entries[player];
+        if (!entry.built) rebuild(entry, player->getInventory());
+        return entry;
+    }
+
+    void InventoryIndex::rebuild(Entry &entry, Container &inv) {
+        auto sz = inv.getSize();
+        entry.slotItem.assign(sz, 0);
+        entry.itemSlots.clear();
+        entry.tools.clear();
+        for (int i = 0; i < sz; i++) {
+            auto id = itemIdOf(inv.getSlot(i));
+            entry.slotItem[i] = id;
+            if (id != 0) entry.itemSlots[id].push_back(i);
+        }
+        entry.built = true;
+    }
+
+    int InventoryIndex::findItem(Player *player, int itemId) {
+        if (!player || itemId == 0) return -1;
+        auto &entry = this->get(player);
+        auto it = entry.itemSlots.find(itemId);
+        if (it == entry.itemSlots.end() || it->second.empty()) return -1;
+        auto slot = it->second.front();
+        // 万一漏了事件，索引和背包对不上就重建一次
+        if (itemIdOf(player->getInventory().getSlot(slot)) != itemId) {
+            rebuild(entry, player->getInventory());
+            it = entry.itemSlots.find(itemId);
+            return it == entry.itemSlots.end() || it->second.empty() ? -1 : it->second.front();
+        }
+        return slot;
+    }
+
+    std::pair<float, int> InventoryIndex::bestTool(Player *player, const Block *block) {
+        if (!player || !block) return {0.0f, -1};
+        auto &entry = this->get(player);
+        auto &inv = player->getInventory();
+        auto it = entry.tools.find(block);
+        if (it != entry.tools.end()) {
+            auto slot = it->second.second;
+            if (slot < 0) return it->second;
+            // 和findItem一样，格子里的东西对不上说明漏了事件，重建后重新计算
+            auto *item = inv.getSlot(slot);
+            if (itemIdOf(item) == entry.slotItem[slot] && usableTool(item)) return it->second;
+            rebuild(entry, inv);
+        }
+        std::pair<float, int> best{0.0f, -1};
+        for (int i = 0; i < static_cast<int>(entry.slotItem.size()); i++) {
+            if (entry.slotItem[i] == 0) continue;
+            auto *item = inv.getSlot(i);
+            if (!usableTool(item)) continue;
+            auto speed = item->getDestroySpeed(*block);
+            if (best.second < 0 || speed > best.first) best = {speed, i};
+        }
+        entry.tools[block] = best;
+        return best;
+    }
+
+    void InventoryIndex::onSlotChanged(Player *player, int slot) {
+        auto it = this->entries.find(player);
+        if (it == this->entries.end() || !it->second.built) return;
+        auto &entry = it->second;
+        if (slot < 0 || slot >= static_cast<int>(entry.slotItem.size())) {
+            entry.tools.clear();
+            entry.built = false;
+            return;
+        }
+        auto *item = player->getInventory().getSlot(slot);
+        auto oldId = entry.slotItem[slot];
+        auto newId = itemIdOf(item);
+        // 挖方块掉耐久也会触发，不能清空整个缓存：耐久不影响挖掘速度，
+        // 指向这个格子的结果只在物品换了或者耐久不够时作废，其余结果只需要和新物品比较一次
+        const bool usable = usableTool(item);
+        for (auto t = entry.tools.begin(); t != entry.tools.end();) {
+            auto &best = t->second;
+            if (best.second == slot) {
+                if (oldId != newId || !usable) {
+                    t = entry.tools.erase(t);
+                } else {
+                    ++t;
                 }
+                continue;
             }
-
-            return curInfo.slot;
+            if (usable) {
+                auto speed = item->getDestroySpeed(*t->first);
+                if (best.second < 0 || speed > best.first ||
+                    (speed == best.first && slot < best.second)) {
+                    best = {speed, slot};
+                }
+            }
+            ++t;
         }
-    }  // namespace
+        if (oldId == newId) return;
+        if (oldId != 0) eraseSlot(entry.itemSlots[oldId], slot);
+        if (newId != 0) insertSlot(entry.itemSlots[newId], slot);
+        entry.slotItem[slot] = newId;
+    }
+
+    void InventoryIndex::remove(Player *player) { this->entries.erase(player); }
 
     void swapItemInContainer(Container &cont, int s1, int s2) {
         auto i1 = cont.getItem(s1).clone();
@@ -60,7 +167,7 @@ namespace trapdoor {
         auto *ins = const_cast<BlockInstance *>(&instance);
         if (!player || player->isCreative() || !ins || ins->isNull()) return true;
         auto curSlot = player->getSelectedItemSlot();
-        auto bestSlot = searchBestToolInInv(player->getInventory(), curSlot, ins->getBlock());
+        auto bestSlot = searchBestToolInInv(player, curSlot, ins->getBlock());
         if (bestSlot == curSlot) {
             auto &item = player->getSelectedItem();
             auto remain = item.getMaxDamage() - item.getDamageValue();
@@ -394,16 +394,53 @@ THook(void, "?removeComponent@CircuitSceneGraph@@AEAAXAEBVBlockPos@@@Z", void *c
 
 THook(void, "?tick@Actor@@QEAA_NAEAVBlockSource@@@Z", Actor *actor, void *bs) {
     auto &prof = trapdoor::normalProfiler();
-    if (prof.profiling) {
+    // 假人的开销一直统计，没有假人时直接跳过，否则先用isPlayer过滤掉绝大多数实体
+    auto &mod = trapdoor::mod();
+    auto &simManager = mod.getSimPlayerManager();
+    auto simSlot =
+        simManager.hasSimPlayers() && actor->isPlayer() ? simManager.slotOf(actor) : -1;
+    if (prof.profiling || simSlot >= 0) {
         TIMER_START
         original(actor, bs);
         TIMER_END
 
-        prof.actorInfo[static_cast<int>(actor->getDimensionId())][actor->getTypeName()].time +=
-            timeResult;
-        prof.actorInfo[static_cast<int>(actor->getDimensionId())][actor->getTypeName()].count++;
+        if (prof.profiling) {
+            auto &info =
+                prof.actorInfo[static_cast<int>(actor->getDimensionId())][actor->getTypeName()];
+            info.time += timeResult;
+            info.count++;
+        }
+        if (simSlot >= 0) simManager.recordActorTick(simSlot, timeResult, actor->getPos());
     } else {
         original(actor, bs);
     }
+    auto &index = mod.getEntityIndex();
+    if (index.isActive()) index.update(actor);
+}
+
+// 生成的实体和随区块加载的实体分别从这两处加入世界
+THook(Actor *,
+      "?addEntity@Level@@UEAAPEAVActor@@AEAVBlockSource@@V?$OwnerPtrT@UEntityRefTraits@@@@@Z",
+      void *level, void *bs, void *owner) {
+    auto *actor = original(level, bs, owner);
+    auto &index = trapdoor::mod().getEntityIndex();
+    if (actor && index.isActive()) index.update(actor);
+    return actor;
+}
+
+THook(Actor *,
+      "?addAutonomousEntity@Level@@UEAAPEAVActor@@AEAVBlockSource@@V?$OwnerPtrT@"
+      "UEntityRefTraits@@@@@Z",
+      void *level, void *bs, void *owner) {
+    auto *actor = original(level, bs, owner);
+    auto &index = trapdoor::mod().getEntityIndex();
+    if (actor && index.isActive()) index.update(actor);
+    return actor;
+}
+
+THook(void, "??1Actor@@UEAA@XZ", Actor *actor) {
+    auto &index = trapdoor::mod().getEntityIndex();
+    if (index.isActive()) index.remove(actor);
+    original(actor);
 }
 // pending add
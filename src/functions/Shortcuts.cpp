@@ -1,6 +1,9 @@
 #include "Shortcuts.h"
 
-#include <FMT/format.h>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
 
 #include <MC/Block.hpp>
 #include <MC/ItemStack.hpp>
@@ -30,8 +33,273 @@ namespace trapdoor {
                 return aux == aux2;             // 检查aux
             }
         }
+
+        const std::unordered_map<std::string, ShortcutArg>& argTable() {
+            static const std::unordered_map<std::string, ShortcutArg> table = {
+                {"px", ShortcutArg::PX},       {"py", ShortcutArg::PY},
+                {"pz", ShortcutArg::PZ},       {"pdim", ShortcutArg::PDim},
+                {"iname", ShortcutArg::IName}, {"iaux", ShortcutArg::IAux},
+                {"bname", ShortcutArg::BName}, {"baux", ShortcutArg::BAux},
+                {"bx", ShortcutArg::BX},       {"by", ShortcutArg::BY},
+                {"bz", ShortcutArg::BZ},
+            };
+            return table;
+        }
+
+        void appendInt(std::string& out, int v) {
+            char buf[16];
+            auto r = std::to_chars(buf, buf + sizeof(buf), v);
+            out.append(buf, r.ptr);
+        }
+
+        inline bool isStringArg(ShortcutArg arg) {
+            return arg == ShortcutArg::IName || arg == ShortcutArg::BName;
+        }
+
+        // 按对齐方式把内容和填充字符写到out里
+        void appendPadded(std::string& out, const char* s, size_t len, int width, char fill,
+                          char align) {
+            size_t pad = width > static_cast<int>(len) ? width - len : 0;
+            size_t left = align == '>' ? pad : align == '^' ? pad / 2 : 0;
+            out.append(left, fill);
+            out.append(s, len);
+            out.append(pad - left, fill);
+        }
     }  // namespace
 
+    bool ActionTemplate::parseSpec(const std::string& str, bool isString, FormatSpec& spec) {
+        size_t i = 0;
+        auto isAlign = [](char c) { return c == '<' || c == '>' || c == '^'; };
+        if (str.size() >= 2 && isAlign(str[1])) {
+            if (str[0] == '{' || str[0] == '}') return false;
+            spec.fill = str[0];
+            spec.align = str[1];
+            i = 2;
+        } else if (!str.empty() && isAlign(str[0])) {
+            spec.align = str[0];
+            i = 1;
+        }
+        if (i < str.size() && (str[i] == '+' || str[i] == '-' || str[i] == ' ')) {
+            if (isString) return false;
+            spec.sign = str[i++];
+        }
+        if (i < str.size() && str[i] == '#') {
+            if (isString) return false;
+            spec.alternate = true;
+            ++i;
+        }
+        if (i < str.size() && str[i] == '0') {
+            if (isString) return false;
+            // 和fmt一样，指定了对齐方式时0只是填充字符
+            if (spec.align) {
+                spec.fill = '0';
+            } else {
+                spec.zeroPad = true;
+            }
+            ++i;
+        }
+        while (i < str.size() && str[i] >= '0' && str[i] <= '9') {
+            spec.width = spec.width * 10 + (str[i++] - '0');
+            if (spec.width > 256) return false;
+        }
+        if (i < str.size() && str[i] == '.') {
+            if (!isString) return false;
+            ++i;
+            if (i >= str.size() || str[i] < '0' || str[i] > '9') return false;
+            spec.precision = 0;
+            while (i < str.size() && str[i] >= '0' && str[i] <= '9') {
+                spec.precision = spec.precision * 10 + (str[i++] - '0');
+                if (spec.precision > 256) return false;
+            }
+        }
+        if (i < str.size()) {
+            spec.type = str[i++];
+            const char* types = isString ? "s" : "dxXobB";
+            if (std::string(types).find(spec.type) == std::string::npos) return false;
+        }
+        return i == str.size();
+    }
+
+    bool ActionTemplate::compile(const std::string& src, uint32_t allowed, std::string& error) {
+        this->literal.clear();
+        this->segments.clear();
+        this->specs.clear();
+        this->used = 0;
+        auto pushLiteral = [this](const char* b, const char* e) {
+            if (b == e) return;
+            auto begin = static_cast<uint32_t>(this->literal.size());
+            this->literal.append(b, e);
+            // 相邻的字面量合并成一段
+            if (!this->segments.empty() && this->segments.back().arg < 0) {
+                this->segments.back().end = static_cast<uint32_t>(this->literal.size());
+            } else {
+                this->segments.push_back({-1, begin, static_cast<uint32_t>(this->literal.size())});
+            }
+        };
+
+        size_t i = 0;
+        while (i < src.size()) {
+            auto p = src.find_first_of("{}", i);
+            if (p == std::string::npos) {
+                pushLiteral(src.data() + i, src.data() + src.size());
+                break;
+            }
+            pushLiteral(src.data() + i, src.data() + p);
+            if (p + 1 < src.size() && src[p + 1] == src[p]) {
+                pushLiteral(src.data() + p, src.data() + p + 1);
+                i = p + 2;
+                continue;
+            }
+            if (src[p] == '}') {
+                error = "unmatched '}' in \"" + src + "\"";
+                return false;
+            }
+            auto close = src.find('}', p + 1);
+            if (close == std::string::npos) {
+                error = "unmatched '{' in \"" + src + "\"";
+                return false;
+            }
+            auto field = src.substr(p + 1, close - p - 1);
+            auto colon = field.find(':');
+            auto name = field.substr(0, colon);
+            auto it = argTable().find(name);
+            if (it == argTable().end() || !(allowed & argBit(it->second))) {
+                error = "unknown placeholder {" + name + "} in \"" + src + "\"";
+                return false;
+            }
+            Segment seg{static_cast<int>(it->second), 0, 0};
+            if (colon != std::string::npos) {
+                FormatSpec spec;
+                if (!parseSpec(field.substr(colon + 1), isStringArg(it->second), spec)) {
+                    error = "invalid format spec {" + field + "} in \"" + src + "\"";
+                    return false;
+                }
+                seg.spec = static_cast<int>(this->specs.size());
+                this->specs.push_back(spec);
+            }
+            this->segments.push_back(seg);
+            this->used |= argBit(it->second);
+            i = close + 1;
+        }
+        return true;
+    }
+
+    void ActionTemplate::render(const ShortcutArgs& args, std::string& out) const {
+        for (auto& seg : this->segments) {
+            if (seg.arg < 0) {
+                out.append(this->literal, seg.begin, seg.end - seg.begin);
+                continue;
+            }
+            auto arg = static_cast<ShortcutArg>(seg.arg);
+            const std::string* str = nullptr;
+            int value = 0;
+            switch (arg) {
+                case ShortcutArg::PX:
+                    value = args.playerPos.x;
+                    break;
+                case ShortcutArg::PY:
+                    value = args.playerPos.y;
+                    break;
+                case ShortcutArg::PZ:
+                    value = args.playerPos.z;
+                    break;
+                case ShortcutArg::PDim:
+                    value = args.dim;
+                    break;
+                case ShortcutArg::IName:
+                    str = &args.itemName;
+                    break;
+                case ShortcutArg::IAux:
+                    value = args.itemAux;
+                    break;
+                case ShortcutArg::BName:
+                    str = &args.blockName;
+                    break;
+                case ShortcutArg::BAux:
+                    value = args.blockAux;
+                    break;
+                case ShortcutArg::BX:
+                    value = args.blockPos.x;
+                    break;
+                case ShortcutArg::BY:
+                    value = args.blockPos.y;
+                    break;
+                case ShortcutArg::BZ:
+                    value = args.blockPos.z;
+                    break;
+            }
+            if (seg.spec < 0) {
+                if (str) {
+                    out += *str;
+                } else {
+                    appendInt(out, value);
+                }
+                continue;
+            }
+
+            auto& spec = this->specs[seg.spec];
+            if (str) {
+                auto len = str->size();
+                if (spec.precision >= 0) len = std::min(len, static_cast<size_t>(spec.precision));
+                appendPadded(out, str->data(), len, spec.width, spec.fill,
+                             spec.align ? spec.align : '<');
+                continue;
+            }
+            // 数字：符号、进制前缀、补0、数字本身
+            char buf[48];
+            size_t n = 0;
+            auto mag = value < 0 ? 0u - static_cast<uint32_t>(value) : static_cast<uint32_t>(value);
+            if (value < 0) {
+                buf[n++] = '-';
+            } else if (spec.sign == '+' || spec.sign == ' ') {
+                buf[n++] = spec.sign;
+            }
+            int base = 10;
+            if (spec.type == 'x' || spec.type == 'X') base = 16;
+            if (spec.type == 'o') base = 8;
+            if (spec.type == 'b' || spec.type == 'B') base = 2;
+            if (spec.alternate && base != 10) {
+                buf[n++] = '0';
+                if (base != 8) buf[n++] = spec.type;
+            }
+            char digits[40];
+            auto r = std::to_chars(digits, digits + sizeof(digits), mag, base);
+            auto count = static_cast<size_t>(r.ptr - digits);
+            if (spec.type == 'X') {
+                for (size_t k = 0; k < count; k++) digits[k] = std::toupper(digits[k]);
+            }
+            if (spec.zeroPad) {
+                auto total = n + count;
+                out.append(buf, n);
+                if (spec.width > static_cast<int>(total)) out.append(spec.width - total, '0');
+                out.append(digits, count);
+                continue;
+            }
+            std::memcpy(buf + n, digits, count);
+            appendPadded(out, buf, n + count, spec.width, spec.fill,
+                         spec.align ? spec.align : '>');
+        }
+    }
+
+    bool compileActions(const std::vector<std::string>& actions, uint32_t allowed,
+                        std::vector<ActionTemplate>& templates, std::string& error) {
+        templates.assign(actions.size(), ActionTemplate());
+        for (size_t i = 0; i < actions.size(); i++) {
+            if (!templates[i].compile(actions[i], allowed, error)) return false;
+        }
+        return true;
+    }
+
+    void runActions(Player* player, const std::vector<ActionTemplate>& templates,
+                    const ShortcutArgs& args, std::string& buffer) {
+        for (auto& t : templates) {
+            buffer.clear();
+            t.render(args, buffer);
+            trapdoor::logger().debug("cmd is {}", buffer);
+            player->runcmd(buffer);
+        }
+    }
+
     void Shortcut::setItem(const string& str) { parsePattern(str, itemName, itemAux); }
     void Shortcut::setBlock(const string& str) { parsePattern(str, blockName, blockAux); }
     bool Shortcut::operator==(const Shortcut& rhs) const {
@@ -86,29 +354,111 @@ namespace trapdoor {
         }
         return false;
     }
-    void Shortcut::runUse(Player* player, ItemStack* item) {
-        auto pos = player->getPos().toBlockPos();
-        for (auto& act : actions) {
-            auto cmd = fmt::format(act, fmt::arg("px", pos.x), fmt::arg("py", pos.y),
-                                   fmt::arg("pz", pos.z), fmt::arg("iname", item->getName()),
-                                   fmt::arg("iaux", item->getAux()));
-            trapdoor::logger().debug("cmd is {}", cmd);
-            player->runcmd(cmd);
+    bool ShortcutIndex::Key::operator==(const Key& rhs) const {
+        return type == rhs.type && item == rhs.item && itemAux == rhs.itemAux &&
+               block == rhs.block && blockAux == rhs.blockAux;
+    }
+
+    size_t ShortcutIndex::KeyHash::operator()(const Key& k) const {
+        size_t h = static_cast<size_t>(k.type);
+        for (int v : {k.item, k.itemAux, k.block, k.blockAux}) {
+            h = h * 1000003u ^ static_cast<size_t>(static_cast<uint32_t>(v));
+        }
+        return h;
+    }
+
+    int ShortcutIndex::nameId(const std::string& name) const {
+        if (name.empty()) return 0;
+        auto it = this->names.find(name);
+        return it == this->names.end() ? -1 : it->second;
+    }
+
+    void ShortcutIndex::build(const std::vector<Shortcut>& shortcuts) {
+        this->names.clear();
+        this->first.clear();
+        auto intern = [this](const std::string& name) {
+            if (name.empty()) return 0;
+            auto id = static_cast<int>(this->names.size()) + 1;
+            return this->names.emplace(name, id).first->second;
+        };
+        for (int i = 0; i < static_cast<int>(shortcuts.size()); i++) {
+            const auto& sh = shortcuts[i];
+            int item = intern(sh.itemName);
+            // USE类型不看方块
+            int block = sh.type == USE ? 0 : intern(sh.blockName);
+            int blockAux = sh.type == USE ? -1 : sh.blockAux;
+            // 同一个键只保留配置里靠前的那个
+            this->first.emplace(Key{sh.type, item, sh.itemAux, block, blockAux}, i);
+        }
+    }
+
+    int ShortcutIndex::find(const Shortcut& query) const {
+        if (this->first.empty()) return -1;
+        const int items[2] = {this->nameId(query.itemName), 0};
+        const int itemAuxes[2] = {query.itemAux, -1};
+        int blocks[2] = {0, -1};
+        int blockAuxes[2] = {-1, -1};
+        int blockVariants = 1;
+        if (query.type != USE) {
+            blocks[0] = this->nameId(query.blockName);
+            blocks[1] = 0;
+            blockAuxes[0] = query.blockAux;
+            blockVariants = 2;
         }
+
+        int best = -1;
+        for (int item : items) {
+            if (item < 0) continue;  // 配置里没出现过的名字只能被通配匹配
+            for (int itemAux : itemAuxes) {
+                for (int b = 0; b < blockVariants; b++) {
+                    if (blocks[b] < 0) continue;
+                    for (int a = 0; a < blockVariants; a++) {
+                        auto it = this->first.find(
+                            Key{query.type, item, itemAux, blocks[b], blockAuxes[a]});
+                        if (it != this->first.end() && (best < 0 || it->second < best)) {
+                            best = it->second;
+                        }
+                    }
+                }
+            }
+        }
+        return best;
+    }
+
+    bool Shortcut::compile(std::string& error) {
+        auto allowed = PLAYER_ARGS | ITEM_ARGS;
+        if (this->type == USE_ON || this->type == DESTROY) allowed |= BLOCK_ARGS;
+        if (!compileActions(this->actions, allowed, this->templates, error)) return false;
+        this->usedArgs = 0;
+        size_t size = 0;
+        for (auto& t : this->templates) {
+            this->usedArgs |= t.usedArgs();
+            size = std::max(size, t.literalSize());
+        }
+        // 预留出占位符展开的空间，执行时一般不会再分配内存
+        this->buffer.reserve(size + 64);
+        return true;
+    }
+
+    void Shortcut::runUse(Player* player, ItemStack* item) {
+        ShortcutArgs args;
+        args.playerPos = player->getPos().toBlockPos();
+        if (this->usedArgs & argBit(ShortcutArg::IName)) args.itemName = item->getName();
+        args.itemAux = item->getAux();
+        runActions(player, this->templates, args, this->buffer);
     }
     void Shortcut::runUseOn(Player* player, const ItemStack* item, Block* block,
                             const BlockPos& p) {
-        auto pos = player->getPos().toBlockPos();
-        for (auto& act : actions) {
-            auto cmd =
-                fmt::format(act, fmt::arg("px", pos.x), fmt::arg("py", pos.y),
-                            fmt::arg("pz", pos.z), fmt::arg("bname", block->getName().getString()),
-                            fmt::arg("baux", block->getVariant()), fmt::arg("bx", p.x),
-                            fmt::arg("by", p.y), fmt::arg("bz", p.z),
-                            fmt::arg("iname", item->getName()), fmt::arg("iaux", item->getAux()));
-            trapdoor::logger().debug("cmd is {}", cmd);
-            player->runcmd(cmd);
+        ShortcutArgs args;
+        args.playerPos = player->getPos().toBlockPos();
+        if (this->usedArgs & argBit(ShortcutArg::IName)) args.itemName = item->getName();
+        args.itemAux = item->getAux();
+        if (this->usedArgs & argBit(ShortcutArg::BName)) {
+            args.blockName = block->getName().getString();
         }
+        args.blockAux = block->getVariant();
+        args.blockPos = p;
+        runActions(player, this->templates, args, this->buffer);
     }
     void Shortcut::runUseDestroy(Player* player, const ItemStack* item, Block* block,
                                  const BlockPos& p) {
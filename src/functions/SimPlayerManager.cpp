@@ -4,10 +4,17 @@
 #include <MC/ItemStack.hpp>
 #include <MC/SimpleContainer.hpp>
 #include <MC/SimulatedPlayer.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
 
+#include "HookAPI.h"
 #include "Msg.h"
-#include "ScheduleAPI.h"
 #include "SimPlayerHelper.h"
+#include "SimpleProfiler.h"
 #include "TrapdoorMod.h"
 namespace trapdoor {
     namespace {
@@ -18,19 +25,6 @@ namespace trapdoor {
         return {"Player dost not exists or in scheduling", false}; \
     }
 
-#define ADD_TASK                                            \
-    task();                                                 \
-    if (repType != 0) {                                     \
-        auto sch = Schedule::repeat(task, interval, times); \
-        this->simPlayers[name].task = sch;                  \
-    }
-
-#define CHECK_SURVIVAL                \
-    if (!this->checkSurvival(name)) { \
-        this->cancel(name);           \
-        return;                       \
-    }
-
         BlockPos getTargetPos(Player* p, BlockPos pos) {
             if (!p) return pos;
             auto* a = reinterpret_cast<Actor*>(p);
@@ -44,111 +38,580 @@ namespace trapdoor {
 
         ItemStack* getItemInInv(SimulatedPlayer* sim, int itemID) {
             if (!sim) return nullptr;
-            auto& inv = sim->getInventory();
-            int sz = inv.getSize();
-            for (int i = 0; i < sz; i++) {
-                auto* item = inv.getSlot(i);
-                if (item && item->getId() == itemID) {
-                    return item;
-                }
-            }
-            return nullptr;
+            auto slot = trapdoor::mod().getInventoryIndex().findItem(sim, itemID);
+            return slot < 0 ? nullptr : sim->getInventory().getSlot(slot);
         }
 
-        void writeInvToFile(Container& cont, const std::string& playerName) {
-            // const std::string path = "./plugins/trapdoor/sim/" + file_name;
-            if (!trapdoor::mod().getConfig().getBasicConfig().keepSimPlayerInv) return;
-            const std::string path =
-                "./plugins/trapdoor/sim/" + std::to_string(do_hash(playerName.c_str()));
-            trapdoor::logger().debug("Path is {}", path);
-            // TODO 序列化背包内容到文件
-            nlohmann::json obj;
-            auto array = nlohmann::json::array();
+        constexpr uint32_t INV_FILE_MAGIC = 0x56495354;  // "TSIV"
+        constexpr uint32_t INV_FILE_VERSION = 1;
+
+        std::string invFilePath(const std::string& playerName) {
+            return "./plugins/trapdoor/sim/" + std::to_string(do_hash(playerName.c_str()));
+        }
+
+        template <typename T>
+        void putRaw(std::string& out, T v) {
+            out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+        }
+
+        template <typename T>
+        bool getRaw(const char*& p, const char* end, T& v) {
+            if (end - p < static_cast<ptrdiff_t>(sizeof(T))) return false;
+            std::memcpy(&v, p, sizeof(T));
+            p += sizeof(T);
+            return true;
+        }
+
+        void putString(std::string& out, const std::string& str) {
+            putRaw<uint32_t>(out, static_cast<uint32_t>(str.size()));
+            out += str;
+        }
+
+        bool getString(const char*& p, const char* end, std::string& str) {
+            uint32_t len = 0;
+            if (!getRaw(p, end, len) || end - p < static_cast<ptrdiff_t>(len)) return false;
+            str.assign(p, len);
+            p += len;
+            return true;
+        }
+
+        // 背包的二进制形式：物品数，然后每个非空格子是(格子, NBT长度, 小端二进制NBT)
+        std::string serializeInventory(Container& cont) {
+            std::string out;
+            putRaw<uint32_t>(out, 0);
+            uint32_t count = 0;
             for (auto i = 0; i < cont.getSize(); i++) {
                 auto* item = cont.getSlot(i);
-                std::string sNbt;
-                if (item) {
-                    sNbt = item->getNbt()->toSNBT();
-                }
-                json j = {{"slot", i}, {"nbt", sNbt}};
-                array.push_back(j);
+                if (!item || item->isNull()) continue;
+                auto nbt = item->getNbt()->toBinaryNBT();
+                putRaw<int32_t>(out, i);
+                putRaw<uint32_t>(out, static_cast<uint32_t>(nbt.size()));
+                out += nbt;
+                ++count;
             }
-            obj["inventory"] = array;
-            obj["name"] = playerName;
-            std::ofstream f(path);
-            if (!f) {
-                trapdoor::logger().error("can not write file {} to disk", path);
-                return;
+            std::memcpy(out.data(), &count, sizeof(count));
+            return out;
+        }
+
+        bool restoreInventory(Container& cont, const char*& p, const char* end) {
+            uint32_t count = 0;
+            if (!getRaw(p, end, count)) return false;
+            for (uint32_t i = 0; i < count; i++) {
+                int32_t slot = 0;
+                uint32_t len = 0;
+                if (!getRaw(p, end, slot) || !getRaw(p, end, len)) return false;
+                if (end - p < static_cast<ptrdiff_t>(len)) return false;
+                auto tag = CompoundTag::fromBinaryNBT(const_cast<char*>(p), len);
+                p += len;
+                if (!tag) continue;
+                std::unique_ptr<ItemStack> item(ItemStack::create(std::move(tag)));
+                if (item) cont.setItem(slot, *item);
             }
+            return true;
+        }
 
-            f << obj;
-            f.close();
+        // 旧版本保存的是SNBT组成的json
+        void readLegacyInv(Container& cont, const std::string& data) {
+            try {
+                auto obj = nlohmann::json::parse(data);
+                for (auto& item : obj["inventory"]) {
+                    auto slot = item["slot"].get<int>();
+                    auto nbt = item["nbt"].get<std::string>();
+                    if (nbt.empty()) continue;
+                    std::unique_ptr<ItemStack> it(ItemStack::create(CompoundTag::fromSNBT(nbt)));
+                    if (it) cont.setItem(slot, *it);
+                }
+            } catch (const std::exception&) {
+            }
         }
 
         void tryReadInvFromFile(Container& cont, const std::string& playerName) {
             if (!trapdoor::mod().getConfig().getBasicConfig().keepSimPlayerInv) return;
-            const std::string path =
-                "./plugins/trapdoor/sim/" + std::to_string(do_hash(playerName.c_str()));
-            // TODO 从文件读取内容到背包
-            std::ifstream f(path);
+            std::ifstream f(invFilePath(playerName), std::ios::binary);
             if (!f.is_open()) {
-                //  trapdoor::logger().warn("can not read file {}", file_name);
                 return;
             }
+            std::string data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+            const char* p = data.data();
+            const char* end = p + data.size();
+            uint32_t magic = 0, version = 0;
+            if (!getRaw(p, end, magic) || magic != INV_FILE_MAGIC) {
+                readLegacyInv(cont, data);
+                return;
+            }
+            if (!getRaw(p, end, version) || version != INV_FILE_VERSION ||
+                !restoreInventory(cont, p, end)) {
+                trapdoor::logger().warn("Broken inventory file of sim player {}", playerName);
+            }
+        }
 
-            nlohmann::json obj;
-            f >> obj;
-            try {
-                auto invInfo = obj["inventory"];
-                for (auto& item : invInfo) {
-                    auto slot = item["slot"].get<int>();
-                    auto* it = ItemStack::create(CompoundTag::fromSNBT(item["nbt"]));
-                    cont.setItem(slot, *it);
+        constexpr auto DEFAULT_FACING = static_cast<ScriptModuleMinecraft::ScriptFacing>(1);
+
+        void stopActing(SimulatedPlayer* sim) {
+            sim->simulateStopUsingItem();
+            sim->simulateStopMoving();
+            sim->simulateStopInteracting();
+            sim->simulateStopDestroyingBlock();
+            sim->stopDestroying();
+            sim->stopRiding(true, true, true);
+            sim->stopSleepInBed(true, true);
+            sim->stopUsingItem();
+        }
+
+        void runAction(const SimAction& action, SimulatedPlayer* sim) {
+            switch (action.type) {
+                case SimActionType::Interact: {
+                    auto* target = Global<Level>->fetchEntity(action.target, true);
+                    if (target) {
+                        sim->simulateInteract(*target);
+                    } else if (action.pos == BlockPos::MAX) {
+                        sim->simulateInteract();
+                    } else {
+                        sim->simulateInteract(action.pos, DEFAULT_FACING);
+                    }
+                    break;
                 }
-            } catch (const std::exception&) {
+                case SimActionType::Attack: {
+                    auto* target = Global<Level>->fetchEntity(action.target, true);
+                    if (target) {
+                        sim->simulateAttack(target);
+                    } else {
+                        sim->simulateAttack();
+                    }
+                    break;
+                }
+                case SimActionType::DestroyOn:
+                    if (action.pos != BlockPos::MAX) {
+                        sim->simulateDestroyBlock(action.pos, DEFAULT_FACING);
+                    }
+                    break;
+                case SimActionType::Destroy: {
+                    auto bi = sim->getBlockFromViewVector();
+                    if (bi.isNull()) {
+                        sim->simulateDestroy();
+                    } else {
+                        sim->simulateDestroyBlock(bi.getPosition(), DEFAULT_FACING);
+                    }
+                    break;
+                }
+                case SimActionType::Jump:
+                    sim->simulateJump();
+                    break;
+                case SimActionType::Use: {
+                    auto* item = getItemInInv(sim, action.itemId);
+                    stopActing(sim);
+                    if (item) {
+                        sim->simulateSetItem(*item, true, 0);
+                        sim->simulateUseItem(*item);
+                    } else {
+                        sim->simulateUseItem();
+                    }
+                    break;
+                }
+                case SimActionType::UseOn: {
+                    auto v = Vec3(0.5, 1.0, 0.5);
+                    auto* item = getItemInInv(sim, action.itemId);
+                    if (item) {
+                        sim->simulateUseItemOnBlock(*item, action.pos, DEFAULT_FACING, v);
+                    }
+                    break;
+                }
+                case SimActionType::Script:
+                    break;
             }
         }
 
-        constexpr auto DEFAULT_FACING = static_cast<ScriptModuleMinecraft::ScriptFacing>(1);
+        // 序列里的单条指令，和命令里对应的动作行为一致
+        void runScriptOp(SimOp op, const int32_t* args, SimulatedPlayer* sim) {
+            SimAction action;
+            switch (op) {
+                case SimOp::Interact:
+                    action.type = SimActionType::Interact;
+                    action.pos = BlockPos::MAX;
+                    break;
+                case SimOp::Attack:
+                    action.type = SimActionType::Attack;
+                    break;
+                case SimOp::Destroy:
+                    action.type = SimActionType::Destroy;
+                    break;
+                case SimOp::DestroyOn:
+                    action.type = SimActionType::DestroyOn;
+                    action.pos = BlockPos(args[0], args[1], args[2]);
+                    break;
+                case SimOp::Jump:
+                    action.type = SimActionType::Jump;
+                    break;
+                case SimOp::Use:
+                    action.type = SimActionType::Use;
+                    action.itemId = args[0];
+                    break;
+                case SimOp::UseOn:
+                    action.type = SimActionType::UseOn;
+                    action.itemId = args[0];
+                    action.pos = BlockPos(args[1], args[2], args[3]);
+                    break;
+                case SimOp::Set: {
+                    auto* item = getItemInInv(sim, args[0]);
+                    if (item) sim->simulateSetItem(*item, true, 0);
+                    return;
+                }
+                case SimOp::LookAt:
+                    sim->simulateLookAt(Vec3(args[0] + 0.5f, args[1] + 0.5f, args[2] + 0.5f));
+                    return;
+                case SimOp::MoveTo:
+                    sim->simulateMoveToLocation(
+                        Vec3(args[0] + 0.5f, args[1] + 1.0f, args[2] + 0.5f), 1.0f);
+                    return;
+                case SimOp::Stop:
+                    stopActing(sim);
+                    return;
+                default:
+                    return;
+            }
+            runAction(action, sim);
+        }
     }  // namespace
 
-    bool SimPlayerManager::checkSurvival(const std::string& name) {
+    SimPlayerManager::SimInfo* SimPlayerManager::findInfo(const std::string& name) {
         auto it = this->simPlayers.find(name);
-        if (it == this->simPlayers.end()) return false;
-        return it->second.simPlayer != nullptr;
+        return it == this->simPlayers.end() ? nullptr : &this->slots[it->second];
+    }
+
+    bool SimPlayerManager::checkSurvival(const std::string& name) {
+        auto* info = this->findInfo(name);
+        return info && info->simPlayer != nullptr;
+    }
+
+    // 动作只在这里释放，代数加一后时间轮里残留的记录会在出队时被跳过，所以取消是O(1)的
+    void SimPlayerManager::cancelAction(SimInfo& info) {
+        if (info.action == NO_ACTION) return;
+        this->markSnapshotDirty();
+        auto& action = this->actions[info.action];
+        action.active = false;
+        ++action.generation;
+        if (action.type == SimActionType::Script) {
+            --this->programs[action.program].refs;
+            this->releaseProgram(action.program);
+        }
+        this->freeActions.push_back(info.action);
+        info.action = NO_ACTION;
     }
 
     void SimPlayerManager::cancel(const std::string& name) {
         trapdoor::logger().debug("cancel task of:{}", name);
-        auto it = this->simPlayers.find(name);
-        if (it != this->simPlayers.end()) {
-            it->second.task.cancel();
-        }
+        auto* info = this->findInfo(name);
+        if (info) this->cancelAction(*info);
     }
 
     void SimPlayerManager::stopAction(const std::string& name) {
         auto* sim = this->tryFetchSimPlayer(name, false);
-        if (sim) {
-            sim->simulateStopUsingItem();
-            sim->simulateStopMoving();
-            sim->simulateStopInteracting();
-            sim->simulateStopDestroyingBlock();
-            sim->stopDestroying();
-            sim->stopRiding(true, true, true);
-            sim->stopSleepInBed(true, true);
-            sim->stopUsingItem();
-        }
+        if (sim) stopActing(sim);
     }
 
     SimulatedPlayer* SimPlayerManager::tryFetchSimPlayer(const std::string& name, bool needFree) {
-        auto it = simPlayers.find(name);
-        if (it == simPlayers.end()) {
-            return nullptr;
+        auto* info = this->findInfo(name);
+        if (!info || !info->simPlayer) return nullptr;
+        if (needFree) return info->action == NO_ACTION ? info->simPlayer : nullptr;
+        return info->simPlayer;
+    }
+
+    ActionResult SimPlayerManager::schedule(const std::string& name, SimAction action,
+                                            int repType, int interval, int times) {
+        auto it = this->simPlayers.find(name);
+        if (it == this->simPlayers.end()) return {"player does not exist", false};
+        auto slot = it->second;
+        if (action.type != SimActionType::Script) {
+            TIMER_START
+            runAction(action, this->slots[slot].simPlayer);
+            TIMER_END
+            this->addCost(this->slots[slot], timeResult, 1);
+        }
+        if (repType == 0) return {"", true};
+        action.interval = std::max(interval, 1);
+        action.remain = times > 0 ? times : -1;
+        this->enqueue(it->second, action, action.interval);
+        return {"", true};
+    }
+
+    void SimPlayerManager::enqueue(uint32_t slot, SimAction action, int delay) {
+        uint32_t id;
+        if (this->freeActions.empty()) {
+            id = static_cast<uint32_t>(this->actions.size());
+            this->actions.emplace_back();
+        } else {
+            id = this->freeActions.back();
+            this->freeActions.pop_back();
+        }
+        auto generation = this->actions[id].generation;
+        action.active = true;
+        action.slot = slot;
+        action.generation = generation;
+        action.due = this->currentTick + std::max(delay, 1);
+        if (action.type == SimActionType::Script) ++this->programs[action.program].refs;
+        this->actions[id] = action;
+        this->slots[slot].action = id;
+        this->wheel[action.due & (WHEEL_SIZE - 1)].push_back({id, generation});
+        this->markSnapshotDirty();
+    }
+
+    int SimPlayerManager::stepScript(uint32_t program, SimScriptState& st, SimulatedPlayer* sim) {
+        // 执行期间动作可能被取消，先占住字节码，防止在执行中途被释放或替换
+        // 重入的调度可能让programs扩容，SimProgram的移动不改变code的缓冲区，所以只记下指针
+        ++this->programs[program].refs;
+        const auto* code = this->programs[program].code.data();
+        auto size = this->programs[program].code.size();
+        uint32_t ops = 0;
+        TIMER_START
+        auto wait = runSimScript(code, size, st, [sim, &ops](SimOp op, const int32_t* args) {
+            runScriptOp(op, args, sim);
+            ++ops;
+        });
+        TIMER_END
+        --this->programs[program].refs;
+        this->releaseProgram(program);
+        auto it = this->actorSlots.find(sim);
+        if (it != this->actorSlots.end()) this->addCost(this->slots[it->second], timeResult, ops);
+        return wait;
+    }
+
+    void SimPlayerManager::addCost(SimInfo& info, int64_t actionTime, uint32_t actions) {
+        info.cost.actionTime += actionTime;
+        info.cost.actions += actions;
+        if (this->profiling) {
+            info.profileCost.actionTime += actionTime;
+            info.profileCost.actions += actions;
+        }
+    }
+
+    int32_t SimPlayerManager::slotOf(const Actor* actor) const {
+        auto it = this->actorSlots.find(actor);
+        return it == this->actorSlots.end() ? -1 : static_cast<int32_t>(it->second);
+    }
+
+    void SimPlayerManager::recordActorTick(int32_t slot, int64_t time, const Vec3& pos) {
+        auto& info = this->slots[slot];
+        SimCost c;
+        c.actorTickTime = time;
+        auto cx = static_cast<int>(std::floor(pos.x)) >> 4;
+        auto cz = static_cast<int>(std::floor(pos.z)) >> 4;
+        // 两个正方形的面积差就是新进入范围的区块数
+        if (info.hasChunk && (cx != info.chunkX || cz != info.chunkZ)) {
+            const int side = SIM_CHUNK_RADIUS * 2 + 1;
+            auto ox = std::max(0, side - std::abs(cx - info.chunkX));
+            auto oz = std::max(0, side - std::abs(cz - info.chunkZ));
+            c.chunksEntered = static_cast<uint32_t>(side * side - ox * oz);
+        }
+        info.hasChunk = true, info.chunkX = cx, info.chunkZ = cz;
+        info.cost.add(c);
+        if (this->profiling) info.profileCost.add(c);
+    }
+
+    void SimPlayerManager::beginProfile() {
+        for (auto& info : this->slots) info.profileCost = SimCost();
+        this->profiling = true;
+    }
+
+    void SimPlayerManager::printProfile(size_t rounds) {
+        this->profiling = false;
+        if (this->simPlayers.empty() || rounds == 0) {
+            trapdoor::BroadcastMessage("No sim player exists");
+            return;
+        }
+        std::vector<std::pair<std::string, SimCost>> v;
+        SimCost sum;
+        for (auto& kv : this->simPlayers) {
+            auto& c = this->slots[kv.second].profileCost;
+            v.emplace_back(kv.first, c);
+            sum.add(c);
+        }
+        std::sort(v.begin(), v.end(), [](const auto& a, const auto& b) {
+            return a.second.total() > b.second.total();
+        });
+        const auto r = static_cast<double>(rounds);
+        TextBuilder builder;
+        builder.sTextF(TB::AQUA | TB::BOLD, "-- Sim players (%zu) --\n", v.size())
+            .textF("Total: %.3f ms/gt, %.1f actions/gt, %u chunks entered\n",
+                   micro_to_mill(sum.total()) / r, sum.actions / r, sum.chunksEntered);
+        for (auto& kv : v) {
+            auto& c = kv.second;
+            builder.text(" - ")
+                .sTextF(TB::GREEN, "%s   ", kv.first.c_str())
+                .textF("%.3f ms ", micro_to_mill(c.total()) / r)
+                .sTextF(TB::GRAY, "(action %.3f, tick %.3f)  ", micro_to_mill(c.actionTime) / r,
+                        micro_to_mill(c.actorTickTime) / r)
+                .textF("%.1f act/gt  %u chunks\n", c.actions / r, c.chunksEntered);
         }
-        auto& simInfo = it->second;
-        if (!simInfo.simPlayer) return nullptr;
-        if (needFree) return simInfo.task.isFinished() ? simInfo.simPlayer : nullptr;
-        return simInfo.simPlayer;
+        trapdoor::BroadcastMessage(builder.get());
+    }
+
+    // 先检查所有玩家，没有可以执行的玩家时不编译
+    // 多个玩家共享同一份字节码，启动期间自己持有一个引用，全部只执行一段就结束时在最后释放
+    ActionResult SimPlayerManager::startProgram(const std::vector<std::string>& names,
+                                                const std::string& key,
+                                                const std::string& source) {
+        std::vector<std::string> ready;
+        std::string failed;
+        ActionResult lastError{"No player is given", false};
+        for (const auto& name : names) {
+            auto* info = this->findInfo(name);
+            if (!info || !info->simPlayer) {
+                lastError = {"player does not exist", false};
+            } else if (info->action != NO_ACTION) {
+                lastError = {"Player is in scheduling", false};
+            } else {
+                ready.push_back(name);
+                continue;
+            }
+            failed += "\n - " + name + ": " + lastError.msg;
+        }
+        if (names.size() == 1 && ready.empty()) return lastError;
+        if (ready.empty()) return {"No player can run it" + failed, false};
+
+        std::vector<int32_t> code;
+        std::string error;
+        if (!compileSimScript(source, code, error)) return {error, false};
+        auto program = this->addProgram(key, std::move(code));
+        ++this->programs[program].refs;
+        ActionResult res{"", true};
+        size_t started = 0;
+        for (const auto& name : ready) {
+            SimAction action;
+            action.type = SimActionType::Script;
+            action.program = program;
+            // 第一段在当前gt执行，剩下的交给时间轮
+            // 前面的玩家执行时可能触发别的命令，重新检查一次
+            auto* info = this->findInfo(name);
+            if (!info || !info->simPlayer || info->action != NO_ACTION) {
+                res = {"Player is not available", false};
+                failed += "\n - " + name + ": " + res.msg;
+                continue;
+            }
+            auto wait = this->stepScript(program, action.script, info->simPlayer);
+            res = wait >= 0 ? this->schedule(name, action, 1, wait, -1) : ActionResult{"", true};
+            if (res.success) {
+                ++started;
+            } else {
+                failed += "\n - " + name + ": " + res.msg;
+            }
+        }
+        --this->programs[program].refs;
+        this->releaseProgram(program);
+        if (names.size() == 1) return res;
+        return {"Started " + std::to_string(started) + "/" + std::to_string(names.size()) +
+                    " players" + failed,
+                true};
+    }
+
+    // 同名且内容相同的序列只保留一份字节码，内容变了而旧的没人用时原地替换
+    uint32_t SimPlayerManager::addProgram(const std::string& key, std::vector<int32_t> code) {
+        auto it = this->programIndex.find(key);
+        if (it != this->programIndex.end()) {
+            auto& program = this->programs[it->second];
+            if (program.code == code) return it->second;
+            if (program.refs == 0) {
+                program.code = std::move(code);
+                return it->second;
+            }
+            // 旧版本还在执行，等引用归零时再释放
+            this->programIndex.erase(it);
+        }
+        uint32_t id;
+        if (this->freePrograms.empty()) {
+            id = static_cast<uint32_t>(this->programs.size());
+            this->programs.emplace_back();
+        } else {
+            id = this->freePrograms.back();
+            this->freePrograms.pop_back();
+        }
+        this->programs[id] = {key, std::move(code), 0};
+        this->programIndex[key] = id;
+        return id;
+    }
+
+    void SimPlayerManager::releaseProgram(uint32_t id) {
+        auto& program = this->programs[id];
+        if (program.refs != 0) return;
+        auto it = this->programIndex.find(program.key);
+        if (it != this->programIndex.end() && it->second == id) this->programIndex.erase(it);
+        program = SimProgram();
+        this->freePrograms.push_back(id);
+    }
+
+    ActionResult SimPlayerManager::runScriptFile(const std::vector<std::string>& names,
+                                                 const std::string& scriptName) {
+        if (scriptName.find_first_of("/\\.") != std::string::npos) {
+            return {"Invalid script name", false};
+        }
+        const std::string path = "./plugins/trapdoor/sim/scripts/" + scriptName + ".txt";
+        std::ifstream f(path);
+        if (!f.is_open()) return {"Can not read " + path, false};
+        std::stringstream ss;
+        ss << f.rdbuf();
+        return this->startProgram(names, scriptName, ss.str());
+    }
+
+    ActionResult SimPlayerManager::runScript(const std::vector<std::string>& names,
+                                             const std::string& source) {
+        return this->startProgram(names, "#" + source, source);
+    }
+
+    void SimPlayerManager::tick() {
+        ++this->currentTick;
+        this->invWriter.reportFailures();
+        if (!this->dirtyInv.empty()) this->flushInventories();
+        if (this->currentTick % COST_WINDOW_TICKS == 0) {
+            for (auto& info : this->slots) {
+                info.lastCost = info.cost;
+                info.cost = SimCost();
+            }
+        }
+        // 有变化时稍等一会再写，位置和朝向另外定期刷新
+        if ((this->snapshotDirty &&
+             this->currentTick - this->snapshotDirtySince >= SNAPSHOT_DEBOUNCE_TICKS) ||
+            (!this->simPlayers.empty() &&
+             this->currentTick - this->lastSnapshot >= SNAPSHOT_REFRESH_TICKS)) {
+            this->writeSnapshot();
+        }
+        auto& bucket = this->wheel[this->currentTick & (WHEEL_SIZE - 1)];
+        if (bucket.empty()) return;
+        this->dueEntries.swap(bucket);
+        for (auto e : this->dueEntries) {
+            // 动作可能重入管理器(比如快捷指令里再调度一个动作)，让actions、slots扩容，
+            // 所以执行时用副本，执行完再按下标取回
+            auto action = this->actions[e.action];
+            if (!action.active || action.generation != e.generation) continue;  // 已取消
+            // 间隔超过一圈的动作还要再转几圈
+            if (action.due > this->currentTick) {
+                bucket.push_back(e);
+                continue;
+            }
+            auto* sim = this->slots[action.slot].simPlayer;
+            if (!sim) {
+                this->cancelAction(this->slots[action.slot]);
+                continue;
+            }
+            int wait = action.interval;
+            if (action.type == SimActionType::Script) {
+                wait = this->stepScript(action.program, action.script, sim);
+            } else {
+                TIMER_START
+                runAction(action, sim);
+                TIMER_END
+                this->addCost(this->slots[action.slot], timeResult, 1);
+            }
+            // 动作执行时可能触发事件把玩家移除，重新检查一次
+            auto& cur = this->actions[e.action];
+            if (!cur.active || cur.generation != e.generation) continue;
+            cur.script = action.script;
+            if (wait < 0 || (cur.remain > 0 && --cur.remain == 0)) {
+                this->cancelAction(this->slots[cur.slot]);
+                continue;
+            }
+            cur.due = this->currentTick + wait;
+            this->wheel[cur.due & (WHEEL_SIZE - 1)].push_back(e);
+        }
+        this->dueEntries.clear();
     }
 
     ActionResult SimPlayerManager::getBackpack(const std::string& name, int slot) {
@@ -178,30 +641,18 @@ namespace trapdoor {
         if (pos == BlockPos::MAX) {
             pos = trapdoor::getLookAtPos(origin);
         }
-        auto task = [name, this, sim, pos]() {
-            CHECK_SURVIVAL
-            if (pos != BlockPos::MAX) {
-                sim->simulateDestroyBlock(pos, DEFAULT_FACING);
-            }
-        };
-        ADD_TASK
-        return {"", true};
+        SimAction action;
+        action.type = SimActionType::DestroyOn;
+        action.pos = pos;
+        return this->schedule(name, action, repType, interval, times);
     }
 
     ActionResult SimPlayerManager::destroySchedule(const std::string& name, int repType,
                                                    int interval, int times) {
         GET_FREE_PLAYER(sim)
-        auto task = [name, this, sim]() {
-            CHECK_SURVIVAL
-            auto bi = sim->getBlockFromViewVector();
-            if (bi.isNull()) {
-                sim->simulateDestroy();
-            } else {
-                sim->simulateDestroyBlock(bi.getPosition(), DEFAULT_FACING);
-            }
-        };
-        ADD_TASK
-        return {"", true};
+        SimAction action;
+        action.type = SimActionType::Destroy;
+        return this->schedule(name, action, repType, interval, times);
     }
 
     ActionResult SimPlayerManager::interactSchedule(const std::string& name, Player* origin,
@@ -213,65 +664,36 @@ namespace trapdoor {
         auto* playerActor = reinterpret_cast<Actor*>(origin);
         auto* target = playerActor->getActorFromViewVector(5.25);
         auto ins = playerActor->getBlockFromViewVector();
-        auto pos = ins.isNull() ? BlockPos::MAX : ins.getPosition();
-        auto task = [this, sim, name, pos, target]() {
-            CHECK_SURVIVAL
-            if (target) {
-                sim->simulateInteract(*target);
-            } else {
-                if (pos == BlockPos::MAX) {
-                    sim->simulateInteract();
-                } else {
-                    sim->simulateInteract(pos, DEFAULT_FACING);
-                }
-            }
-        };
-        ADD_TASK
-        return {"", true};
+        SimAction action;
+        action.type = SimActionType::Interact;
+        action.pos = ins.isNull() ? BlockPos::MAX : ins.getPosition();
+        // 只记录实体ID，执行时再取，避免实体被移除后悬空
+        if (target) action.target = target->getUniqueID();
+        return this->schedule(name, action, repType, interval, times);
     }
 
     ActionResult SimPlayerManager::attackSchedule(const std::string& name, Player* origin,
                                                   int repType, int interval, int times) {
         GET_FREE_PLAYER(sim)
-        Actor* target = nullptr;
-        ActorUniqueID uid;
+        SimAction action;
+        action.type = SimActionType::Attack;
         if (origin) {
             auto* playerActor = reinterpret_cast<Actor*>(origin);
-            target = playerActor->getActorFromViewVector(5.25);
+            auto* target = playerActor->getActorFromViewVector(5.25);
             if (target) {
-                uid = target->getUniqueID();
+                action.target = target->getUniqueID();
             }
         }
-
-        auto task = [this, name, sim, uid]() {
-            CHECK_SURVIVAL
-            auto t = Global<Level>->fetchEntity(uid, true);
-            if (t) {
-                sim->simulateAttack(t);
-            } else {
-                sim->simulateAttack();
-            }
-        };
-        ADD_TASK
-        return {"", true};
+        return this->schedule(name, action, repType, interval, times);
     }
 
     ActionResult SimPlayerManager::useSchedule(const std::string& name, int itemId, int repType,
                                                int interval, int times) {
         GET_FREE_PLAYER(sim)
-        auto task = [this, name, sim, itemId]() {
-            CHECK_SURVIVAL
-            auto* item = getItemInInv(sim, itemId);
-            this->stopAction(name);
-            if (item) {
-                sim->simulateSetItem(*item, true, 0);
-                sim->simulateUseItem(*item);
-            } else {
-                sim->simulateUseItem();
-            }
-        };
-        ADD_TASK
-        return {"", true};
+        SimAction action;
+        action.type = SimActionType::Use;
+        action.itemId = itemId;
+        return this->schedule(name, action, repType, interval, times);
     }
 
     ActionResult SimPlayerManager::jumpSchedule(const std::string& name, int repType, int interval,
@@ -280,29 +702,20 @@ namespace trapdoor {
         if (!sim) {
             return {"No player or player is in scheduling", false};
         }
-        auto task = [this, name, sim]() {
-            CHECK_SURVIVAL
-            sim->simulateJump();
-        };
-        ADD_TASK
-        return {"", true};
+        SimAction action;
+        action.type = SimActionType::Jump;
+        return this->schedule(name, action, repType, interval, times);
     }
 
     ActionResult SimPlayerManager::useOnBlockSchedule(const std::string& name, int itemId,
                                                       const BlockPos& p, Player* ori, int repType,
                                                       int interval, int times) {
         GET_FREE_PLAYER(sim)
-        auto pos = getTargetPos(ori, p);
-        auto task = [this, name, pos, itemId, sim]() {
-            CHECK_SURVIVAL
-            auto v = Vec3(0.5, 1.0, 0.5);
-            auto* item = getItemInInv(sim, itemId);
-            if (item) {
-                sim->simulateUseItemOnBlock(*item, pos, DEFAULT_FACING, v);
-            }
-        };
-        ADD_TASK
-        return {"", true};
+        SimAction action;
+        action.type = SimActionType::UseOn;
+        action.itemId = itemId;
+        action.pos = getTargetPos(ori, p);
+        return this->schedule(name, action, repType, interval, times);
     }
     ActionResult SimPlayerManager::setItem(const string& name, int itemId) {
         GET_FREE_PLAYER(sim)
@@ -341,22 +754,37 @@ namespace trapdoor {
             return {"player does not exist", false};
         }
 
-        it->second.task.cancel();
-        if (it->second.simPlayer) it->second.simPlayer->simulateDisconnect();
-        simPlayers.erase(name);
-        this->syncPlayerListToFile();
+        auto slot = it->second;
+        auto& info = this->slots[slot];
+        this->cancelAction(info);
+        // 下线的假人不在快照里，背包单独存一份，下次同名假人上线时读回
+        if (info.simPlayer && trapdoor::mod().getConfig().getBasicConfig().keepSimPlayerInv) {
+            std::string data;
+            putRaw(data, INV_FILE_MAGIC);
+            putRaw(data, INV_FILE_VERSION);
+            data += serializeInventory(info.simPlayer->getInventory());
+            this->invWriter.submit(invFilePath(name), std::move(data));
+        }
+        auto* sim = info.simPlayer;
+        if (sim) trapdoor::mod().getInventoryIndex().remove(sim);
+        if (sim) this->actorSlots.erase(sim);
+        info = SimInfo();
+        this->freeSlots.push_back(slot);
+        simPlayers.erase(it);
+        if (sim) sim->simulateDisconnect();
+        this->markSnapshotDirty();
         this->refreshCommandSoftEnum();
         return {"", true};
     }
 
     ActionResult SimPlayerManager::addPlayer(const std::string& name, const BlockPos& p, int dimID,
-                                             Player* origin) {
-        auto iter = this->simPlayers.find(name);
-        if (iter != simPlayers.end() && iter->second.simPlayer) {
+                                             Player* origin, bool readInvFile) {
+        auto* info = this->findInfo(name);
+        if (info && info->simPlayer) {
             return {"Player has already existed", false};
         }
-        if (iter != simPlayers.end()) {
-            iter->second.task.cancel();
+        if (info) {
+            this->cancelAction(*info);
         }
         auto* sim = SimulatedPlayer::create(name, p, dimID);
 
@@ -368,33 +796,55 @@ namespace trapdoor {
             auto rot = origin->getRotation();
             sim->teleport(origin->getPos() - Vec3(0.0f, 1.62f, 0.0f), dimID, rot.x, rot.y);
         }
-        this->simPlayers[name] = {name, sim, ScheduleTask()};
-        tryReadInvFromFile(sim->getInventory(), name);
+        if (!info) {
+            uint32_t slot;
+            if (this->freeSlots.empty()) {
+                slot = static_cast<uint32_t>(this->slots.size());
+                this->slots.emplace_back();
+            } else {
+                slot = this->freeSlots.back();
+                this->freeSlots.pop_back();
+            }
+            this->simPlayers[name] = slot;
+            info = &this->slots[slot];
+        }
+        info->name = name;
+        info->simPlayer = sim;
+        this->actorSlots[sim] = this->simPlayers[name];
+        if (readInvFile) {
+            // 同名假人刚下线时背包可能还在写
+            this->invWriter.flush();
+            tryReadInvFromFile(sim->getInventory(), name);
+        }
         this->refreshCommandSoftEnum();
-        this->syncPlayerListToFile();
+        this->markSnapshotDirty();
         return {"", true};
     }
 
-    // 定时做垃圾回收，解决数据不同步问题
-    void SimPlayerManager::tick() {}
     ActionResult SimPlayerManager::listAll() {
         if (this->simPlayers.empty()) {
             return {"No player exists", true};
         }
         TextBuilder builder;
-        for (const auto& i : this->simPlayers) {
-            builder.text(" - ").textF("%s   ", i.first.c_str());
-            if (!i.second.simPlayer) {
+        for (const auto& kv : this->simPlayers) {
+            const auto& i = this->slots[kv.second];
+            builder.text(" - ").textF("%s   ", kv.first.c_str());
+            if (!i.simPlayer) {
                 builder.sText(TB::RED | TB::BOLD, "Not exist\n");
             } else {
-                if (i.second.task.isFinished()) {
+                if (i.action == NO_ACTION) {
                     builder.sText(TB::GREEN | TB::BOLD, "Free      ");
                 } else {
                     builder.sText(TB::YELLOW | TB::BOLD, "Working   ");
                 }
-                auto pos = i.second.simPlayer->getPosition().toBlockPos();
-                auto dim = i.second.simPlayer->getDimensionId();
-                builder.textF("  %d @ [%d %d %d]\n", static_cast<int>(dim), pos.x, pos.y, pos.z);
+                auto pos = i.simPlayer->getPosition().toBlockPos();
+                auto dim = i.simPlayer->getDimensionId();
+                builder.textF("  %d @ [%d %d %d]", static_cast<int>(dim), pos.x, pos.y, pos.z);
+                // 上一个完整窗口的平均值
+                const auto& c = i.lastCost;
+                const auto w = static_cast<double>(COST_WINDOW_TICKS);
+                builder.sTextF(TB::GRAY, "  %.3f ms/gt  %.1f act/gt  %u chunks\n",
+                               micro_to_mill(c.total()) / w, c.actions / w, c.chunksEntered);
             }
         }
 
@@ -412,43 +862,229 @@ namespace trapdoor {
         }
         cmdInstance->setSoftEnum("name", names);
     }
+    // 只记下背包变了，真正的序列化在tick里合并进行
     void SimPlayerManager::tryRefreshInv(Player* player) {
         if (!player) return;
-        auto name = player->getRealName();
-        auto iter = this->simPlayers.find(name);
-        if (iter == this->simPlayers.end()) return;
-        writeInvToFile(player->getInventory(), name);
+        if (!trapdoor::mod().getConfig().getBasicConfig().keepSimPlayerInv) return;
+        auto it = this->simPlayers.find(player->getRealName());
+        if (it == this->simPlayers.end()) return;
+        auto& info = this->slots[it->second];
+        if (!info.invDirty) {
+            info.invDirty = true;
+            info.invDirtySince = this->currentTick;
+            this->dirtyInv.push_back(it->second);
+        }
+        info.invChangedAt = this->currentTick;
     }
-    void SimPlayerManager::syncPlayerListToFile() {
-        const std::string path = "./plugins/trapdoor/sim/cache.json";
-        nlohmann::json obj;
-        for (auto& sim : this->simPlayers) {
-            auto* p = sim.second.simPlayer;
-            if (p) {
-                auto pos = p->getPos();
-                json j = {
-                    {"x", pos.x}, {"y", pos.y}, {"z", pos.z}, {"dim", (int)p->getDimensionId()}};
-                obj[sim.first] = j;
+
+    // 背包编码结果缓存起来，写快照时没变化的玩家直接复用
+    void SimPlayerManager::saveInventory(SimInfo& info) {
+        info.invDirty = false;
+        if (!info.simPlayer) return;
+        info.invBlob = serializeInventory(info.simPlayer->getInventory());
+        this->markSnapshotDirty();
+    }
+
+    // 背包安静了INV_DEBOUNCE_TICKS，或者距离第一次变化超过INV_MAX_DELAY_TICKS时保存
+    void SimPlayerManager::flushInventories() {
+        for (size_t i = 0; i < this->dirtyInv.size();) {
+            auto& info = this->slots[this->dirtyInv[i]];
+            if (info.invDirty && this->currentTick - info.invChangedAt < INV_DEBOUNCE_TICKS &&
+                this->currentTick - info.invDirtySince < INV_MAX_DELAY_TICKS) {
+                ++i;
+                continue;
             }
+            if (info.invDirty) this->saveInventory(info);
+            this->dirtyInv[i] = this->dirtyInv.back();
+            this->dirtyInv.pop_back();
         }
+    }
 
-        std::ofstream f(path);
-        if (!f.is_open()) {
-            return;
+    void SimPlayerManager::flushOnStop() {
+        for (auto slot : this->dirtyInv) {
+            auto& info = this->slots[slot];
+            if (info.invDirty) this->saveInventory(info);
         }
-        f << obj.dump(4);
-        f.close();
+        this->dirtyInv.clear();
+        // 位置、动作和背包只在快照里，这里必须写一次
+        if (!this->simPlayers.empty() || this->snapshotDirty) this->writeSnapshot();
+        this->invWriter.flush();
+        this->invWriter.reportFailures();
+    }
+
+    void SimPlayerManager::markSnapshotDirty() {
+        if (this->snapshotDirty) return;
+        this->snapshotDirty = true;
+        this->snapshotDirtySince = this->currentTick;
+    }
+
+    // 快照格式：魔数、版本、玩家数，然后每个玩家是(记录长度, 记录)，读的时候可以逐条解析
+    // 记录：名字、位置、朝向、维度、正在执行的动作、背包
+    void SimPlayerManager::writeSnapshot() {
+        this->snapshotDirty = false;
+        this->lastSnapshot = this->currentTick;
+        const bool keepInv = trapdoor::mod().getConfig().getBasicConfig().keepSimPlayerInv;
+        std::string data;
+        putRaw(data, SNAPSHOT_MAGIC);
+        putRaw(data, SNAPSHOT_VERSION);
+        putRaw<uint32_t>(data, 0);
+        uint32_t count = 0;
+        std::string rec;
+        for (auto& kv : this->simPlayers) {
+            auto& info = this->slots[kv.second];
+            auto* sim = info.simPlayer;
+            if (!sim) continue;
+            rec.clear();
+            putString(rec, kv.first);
+            auto pos = sim->getPos() - Vec3(0.0f, 1.62f, 0.0f);
+            auto rot = sim->getRotation();
+            putRaw(rec, pos.x), putRaw(rec, pos.y), putRaw(rec, pos.z);
+            putRaw(rec, rot.x), putRaw(rec, rot.y);
+            putRaw<int32_t>(rec, static_cast<int>(sim->getDimensionId()));
+
+            putRaw<uint8_t>(rec, info.action != NO_ACTION);
+            if (info.action != NO_ACTION) {
+                auto& a = this->actions[info.action];
+                putRaw(rec, static_cast<uint8_t>(a.type));
+                putRaw<int32_t>(rec, a.interval);
+                putRaw<int32_t>(rec, a.remain);
+                putRaw<int32_t>(rec, static_cast<int32_t>(a.due - this->currentTick));
+                putRaw<int32_t>(rec, a.itemId);
+                putRaw(rec, a.pos.x), putRaw(rec, a.pos.y), putRaw(rec, a.pos.z);
+                putRaw<int64_t>(rec, a.target.id);
+                if (a.type == SimActionType::Script) {
+                    auto& program = this->programs[a.program];
+                    putString(rec, program.key);
+                    putRaw<uint32_t>(rec, static_cast<uint32_t>(program.code.size()));
+                    rec.append(reinterpret_cast<const char*>(program.code.data()),
+                               program.code.size() * sizeof(int32_t));
+                    putRaw(rec, a.script);
+                }
+            }
+
+            if (keepInv && (info.invDirty || info.invBlob.empty())) this->saveInventory(info);
+            if (keepInv) {
+                rec += info.invBlob;
+            } else {
+                putRaw<uint32_t>(rec, 0);
+            }
+            putRaw<uint32_t>(data, static_cast<uint32_t>(rec.size()));
+            data += rec;
+            ++count;
+        }
+        std::memcpy(data.data() + 2 * sizeof(uint32_t), &count, sizeof(count));
+        // saveInventory会重新标脏，这里写的已经是最新的
+        this->snapshotDirty = false;
+        this->invWriter.submit(SNAPSHOT_PATH, std::move(data));
+    }
+
+    bool SimPlayerManager::restoreRecord(const char* p, const char* end) {
+        std::string name;
+        Vec3 pos;
+        Vec2 rot;
+        int32_t dim = 0;
+        uint8_t hasAction = 0;
+        if (!getString(p, end, name) || !getRaw(p, end, pos.x) || !getRaw(p, end, pos.y) ||
+            !getRaw(p, end, pos.z) || !getRaw(p, end, rot.x) || !getRaw(p, end, rot.y) ||
+            !getRaw(p, end, dim) || !getRaw(p, end, hasAction)) {
+            return false;
+        }
+
+        SimAction action;
+        int32_t wait = 1;
+        if (hasAction) {
+            uint8_t type = 0;
+            int64_t target = 0;
+            if (!getRaw(p, end, type) || !getRaw(p, end, action.interval) ||
+                !getRaw(p, end, action.remain) || !getRaw(p, end, wait) ||
+                !getRaw(p, end, action.itemId) || !getRaw(p, end, action.pos.x) ||
+                !getRaw(p, end, action.pos.y) || !getRaw(p, end, action.pos.z) ||
+                !getRaw(p, end, target) || type > static_cast<uint8_t>(SimActionType::Script)) {
+                return false;
+            }
+            action.type = static_cast<SimActionType>(type);
+            action.target.id = target;
+            if (action.type == SimActionType::Script) {
+                std::string key;
+                uint32_t size = 0;
+                if (!getString(p, end, key) || !getRaw(p, end, size) ||
+                    end - p < static_cast<ptrdiff_t>(size * sizeof(int32_t))) {
+                    return false;
+                }
+                std::vector<int32_t> code(size);
+                std::memcpy(code.data(), p, size * sizeof(int32_t));
+                p += size * sizeof(int32_t);
+                if (!getRaw(p, end, action.script)) return false;
+                std::string error;
+                if (!verifySimScript(code, action.script, error)) {
+                    trapdoor::logger().warn("Broken script of sim player {}: {}", name, error);
+                    return false;
+                }
+                action.program = this->addProgram(key, std::move(code));
+            }
+        }
+
+        auto res = this->addPlayer(name, BlockPos(pos.x, pos.y, pos.z), dim, nullptr, false);
+        auto* info = this->findInfo(name);
+        if (!res.success || !info || !info->simPlayer) {
+            trapdoor::logger().error("Can not restore sim player [{}]: {}", name, res.msg);
+            if (hasAction && action.type == SimActionType::Script) {
+                this->releaseProgram(action.program);
+            }
+            return true;
+        }
+        auto* sim = info->simPlayer;
+        sim->teleport(pos, dim, rot.x, rot.y);
+        if (trapdoor::mod().getConfig().getBasicConfig().keepSimPlayerInv &&
+            !restoreInventory(sim->getInventory(), p, end)) {
+            trapdoor::logger().warn("Broken inventory of sim player {} in snapshot", name);
+        }
+        if (hasAction) {
+            // 还原时保留距离下次执行的间隔
+            action.interval = std::max(action.interval, 1);
+            this->enqueue(this->simPlayers[name], action, wait);
+        }
+        trapdoor::logger().debug("Restore sim player [{}] at {},{},{} in dim {}", name, pos.x,
+                                 pos.y, pos.z, dim);
+        return true;
+    }
+
+    // 逐条读记录，坏掉的记录跳过，不影响后面的玩家
+    bool SimPlayerManager::readSnapshot() {
+        std::ifstream f(SNAPSHOT_PATH, std::ios::binary);
+        if (!f.is_open()) return false;
+        uint32_t magic = 0, version = 0, count = 0;
+        f.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+        f.read(reinterpret_cast<char*>(&version), sizeof(version));
+        f.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if (!f || magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION) {
+            trapdoor::logger().error("Unsupported sim player snapshot {}", SNAPSHOT_PATH);
+            return false;
+        }
+        std::string rec;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t len = 0;
+            if (!f.read(reinterpret_cast<char*>(&len), sizeof(len))) break;
+            rec.resize(len);
+            if (!f.read(rec.data(), len)) break;
+            if (!this->restoreRecord(rec.data(), rec.data() + rec.size())) {
+                trapdoor::logger().warn("Skip broken sim player record #{}", i);
+            }
+        }
+        return true;
     }
 
     void SimPlayerManager::addPlayersInCache() {
+        if (this->readSnapshot()) return;
+        // 旧版本的cache.json，读完以后会在下一次保存时换成快照
         const std::string path = "./plugins/trapdoor/sim/cache.json";
         nlohmann::json obj;
         std::ifstream i(path);
         if (!i.is_open()) {
             return;
         }
-        i >> obj;
         try {
+            i >> obj;
             for (const auto& item : obj.items()) {
                 const auto name = item.key();
                 const auto& value = item.value();
@@ -459,7 +1095,6 @@ namespace trapdoor {
                 this->addPlayer(name, {x, y, z}, dim, nullptr);
                 trapdoor::logger().debug("Spawn sim player [{}] at {},{},{} in dim {}", name, x, y,
                                          z, dim);
-                //    tempConfig.enable = value["enable"].get<bool>();
             }
         } catch (const std::exception& e) {
             trapdoor::logger().error("error read sim player cache: {}", e.what());
@@ -469,3 +1104,9 @@ namespace trapdoor {
     }
 
 }  // namespace trapdoor
+
+// ServerStoppedEvent在leaveGameSync执行完以后才触发，那时假人可能已经析构，所以在世界卸载前先保存
+THook(void, "?leaveGameSync@ServerInstance@@QEAAXXZ", void* self) {
+    trapdoor::mod().getSimPlayerManager().flushOnStop();
+    original(self);
+}
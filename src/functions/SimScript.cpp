@@ -0,0 +1,188 @@
+#include "SimScript.h"
+
+#include <cstdlib>
+#include <sstream>
+#include <unordered_map>
+
+namespace trapdoor {
+    namespace {
+        struct OpInfo {
+            SimOp op;
+            int argc;      // 文本里的参数个数，end的跳转目标由编译器填写
+            int optional;  // 可以省略的参数个数，省略时填0
+        };
+
+        const std::unordered_map<std::string, OpInfo> &opTable() {
+            static const std::unordered_map<std::string, OpInfo> table = {
+                {"interact", {SimOp::Interact, 0, 0}},
+                {"attack", {SimOp::Attack, 0, 0}},
+                {"destroy", {SimOp::Destroy, 0, 0}},
+                {"destroyon", {SimOp::DestroyOn, 3, 0}},
+                {"jump", {SimOp::Jump, 0, 0}},
+                {"use", {SimOp::Use, 1, 1}},
+                {"useon", {SimOp::UseOn, 4, 0}},
+                {"set", {SimOp::Set, 1, 0}},
+                {"lookat", {SimOp::LookAt, 3, 0}},
+                {"moveto", {SimOp::MoveTo, 3, 0}},
+                {"stop", {SimOp::Stop, 0, 0}},
+                {"wait", {SimOp::Wait, 1, 0}},
+                {"repeat", {SimOp::Repeat, 1, 0}},
+                {"end", {SimOp::End, 0, 0}},
+            };
+            return table;
+        }
+
+        bool parseInt(const std::string &s, int32_t &v) {
+            char *end = nullptr;
+            auto r = std::strtol(s.c_str(), &end, 10);
+            if (s.empty() || *end != '\0') return false;
+            v = static_cast<int32_t>(r);
+            return true;
+        }
+    }  // namespace
+
+    int simOpArgc(SimOp op) {
+        switch (op) {
+            case SimOp::Use:
+            case SimOp::Set:
+            case SimOp::Wait:
+            case SimOp::Repeat:
+            case SimOp::End:
+                return 1;
+            case SimOp::DestroyOn:
+            case SimOp::LookAt:
+            case SimOp::MoveTo:
+                return 3;
+            case SimOp::UseOn:
+                return 4;
+            default:
+                return 0;
+        }
+    }
+
+    bool compileSimScript(const std::string &src, std::vector<int32_t> &code, std::string &error) {
+        code.clear();
+        std::vector<int32_t> loopStarts;
+        // 注释去掉以后分号和换行一样当作语句分隔
+        std::vector<std::string> statements;
+        std::istringstream lines(src);
+        for (std::string line; std::getline(lines, line);) {
+            line = line.substr(0, line.find('#'));
+            std::istringstream parts(line);
+            for (std::string part; std::getline(parts, part, ';');) statements.push_back(part);
+        }
+        for (size_t stmt = 0; stmt < statements.size(); stmt++) {
+            std::istringstream line(statements[stmt]);
+            std::vector<std::string> words;
+            for (std::string w; line >> w;) words.push_back(w);
+            if (words.empty()) continue;
+            const auto where = " in statement " + std::to_string(stmt + 1);
+            auto it = opTable().find(words[0]);
+            if (it == opTable().end()) {
+                error = "Unknown action '" + words[0] + "'" + where;
+                return false;
+            }
+            auto &info = it->second;
+            int given = static_cast<int>(words.size()) - 1;
+            if (given > info.argc || given < info.argc - info.optional) {
+                error = "'" + words[0] + "' needs " + std::to_string(info.argc) +
+                        " arguments" + where;
+                return false;
+            }
+            std::vector<int32_t> args(simOpArgc(info.op), 0);
+            for (int a = 0; a < given; a++) {
+                if (!parseInt(words[a + 1], args[a])) {
+                    error = "Invalid number '" + words[a + 1] + "'" + where;
+                    return false;
+                }
+            }
+            if (info.op == SimOp::Wait && args[0] <= 0) {
+                error = "wait needs a positive tick count" + where;
+                return false;
+            }
+            if (info.op == SimOp::Repeat) {
+                if (args[0] < 0) {
+                    error = "repeat count can not be negative" + where;
+                    return false;
+                }
+                if (loopStarts.size() >= SimScriptState::MAX_LOOP_DEPTH) {
+                    error = "Loops are nested too deep" + where;
+                    return false;
+                }
+            }
+            if (info.op == SimOp::End) {
+                if (loopStarts.empty()) {
+                    error = "'end' without 'repeat'" + where;
+                    return false;
+                }
+                args[0] = loopStarts.back();
+                loopStarts.pop_back();
+            }
+            code.push_back(static_cast<int32_t>(info.op));
+            code.insert(code.end(), args.begin(), args.end());
+            if (info.op == SimOp::Repeat) loopStarts.push_back(static_cast<int32_t>(code.size()));
+        }
+        if (!loopStarts.empty()) {
+            error = "Missing 'end' for 'repeat'";
+            return false;
+        }
+        return true;
+    }
+
+    bool verifySimScript(const std::vector<int32_t> &code, const SimScriptState &st,
+                         std::string &error) {
+        std::vector<int32_t> loopStarts;
+        int stateDepth = -1;  // st.pc所在位置的循环层数
+        size_t pc = 0;
+        while (pc < code.size()) {
+            if (pc == st.pc) stateDepth = static_cast<int>(loopStarts.size());
+            const auto where = " at " + std::to_string(pc);
+            if (code[pc] < 0 || code[pc] > static_cast<int32_t>(SimOp::End)) {
+                error = "Unknown opcode" + where;
+                return false;
+            }
+            auto op = static_cast<SimOp>(code[pc]);
+            auto next = pc + 1 + simOpArgc(op);
+            if (next > code.size()) {
+                error = "Truncated instruction" + where;
+                return false;
+            }
+            auto arg = next > pc + 1 ? code[pc + 1] : 0;
+            if (op == SimOp::Wait && arg <= 0) {
+                error = "Non-positive wait" + where;
+                return false;
+            }
+            if (op == SimOp::Repeat) {
+                if (arg < 0 || loopStarts.size() >= SimScriptState::MAX_LOOP_DEPTH) {
+                    error = "Invalid repeat" + where;
+                    return false;
+                }
+                loopStarts.push_back(static_cast<int32_t>(next));
+            }
+            if (op == SimOp::End) {
+                if (loopStarts.empty() || loopStarts.back() != arg) {
+                    error = "Invalid end" + where;
+                    return false;
+                }
+                loopStarts.pop_back();
+            }
+            pc = next;
+        }
+        if (!loopStarts.empty()) {
+            error = "Missing end";
+            return false;
+        }
+        if (st.pc == code.size()) stateDepth = 0;
+        if (stateDepth < 0 || st.depth != stateDepth) {
+            error = "Invalid program counter";
+            return false;
+        }
+        for (size_t i = 0; i < st.depth; i++) {
+            if (st.loops[i] == 0 || st.loops[i] < -1) {
+                error = "Invalid loop counter";
+                return false;
+            }
+        }
+        return true;
+    }
+}  // namespace trapdoor
@@ -84,6 +84,7 @@ namespace trapdoor {
     void SimpleProfiler::start(size_t round, SimpleProfiler::Type t) {
         trapdoor::logger().debug("Begin profiling with total round {}", round);
         this->reset(t);
+        if (t == SimpleProfiler::Sim) trapdoor::mod().getSimPlayerManager().beginProfile();
         this->profiling = true;
         this->currentRound = 0;
         this->totalRound = round;
@@ -110,6 +111,9 @@ namespace trapdoor {
             case SimpleProfiler::Chunk:
                 this->printChunks();
                 break;
+            case SimpleProfiler::Sim:
+                trapdoor::mod().getSimPlayerManager().printProfile(this->totalRound);
+                break;
         }
     }
 
@@ -1,42 +1,62 @@
 #include "SlimeChunkHelper.h"
 
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "DataConverter.h"
+#include "Msg.h"
 #include "Particle.h"
 
 namespace trapdoor {
+    namespace {
+        constexpr int MAX_FIND_RANGE = 5000;
+        constexpr int MAX_FIND_WINDOW = 8;
+    }  // namespace
+
     void SlimeChunkHelper::HeavyTick() {
+        if (this->finder.hasResult()) this->deliverFinderResult();
         static int gt = 0;
         constexpr int frequency = 100;
+        constexpr int checkInterval = 20;
         if (!this->showSlime) return;
-        if (gt % frequency == 0) {
-            this->updateChunkPosList();
-            this->draw();
+        // 位置检查比较便宜，频繁一点；粒子只在有变化或者到刷新周期时才重画
+        if (gt % checkInterval == 0) {
+            if (this->updateChunkPosList() || gt % frequency == 0) this->draw();
         }
         gt = (gt + 1) % frequency;
     }
 
-    void SlimeChunkHelper::updateChunkPosList() {
-        if (!this->showSlime) return;
-        this->posList.clear();
+    bool SlimeChunkHelper::updateChunkPosList() {
+        if (!this->showSlime) return false;
+        bool changed = false;
+        std::unordered_map<std::string, SlimeView> alive;
         Global<Level>->forEachPlayer([&](Player &player) {
             if (player.getDimensionId() == 0) {  // 遍历主世界玩家
-                int num = 0;
                 auto playerPos = player.getPosition();
                 trapdoor::TBlockPos tPos(playerPos.x, playerPos.y, playerPos.z);
                 auto playerChunkPos = tPos.toChunkPos();
-                auto pos = playerChunkPos;
-                for (int i = -showRadius; i < showRadius; i++) {
-                    for (int j = -showRadius; j < showRadius; j++) {
-                        pos.x = playerChunkPos.x + i;
-                        pos.z = playerChunkPos.z + j;
-                        if (pos.isSlimeChunk()) {
-                            ++num;
-                            this->posList.insert(pos);
-                        }
-                    }
+                auto name = player.getRealName();
+                auto it = this->views.find(name);
+                auto &view = alive[name];
+                if (it != this->views.end()) {
+                    view = std::move(it->second);
+                } else {
+                    changed = true;
                 }
+                changed |= view.moveTo(playerChunkPos.x, playerChunkPos.z, this->showRadius);
             }
             return true;
         });
+        if (alive.size() != this->views.size()) changed = true;
+        this->views.swap(alive);
+        if (!changed) return false;
+
+        this->posList.clear();
+        for (auto &kv : this->views) {
+            kv.second.forEach([&](int x, int z) { this->posList.insert({x, z}); });
+        }
+        return true;
     }
 
     ActionResult SlimeChunkHelper::draw() {
@@ -48,4 +68,58 @@ namespace trapdoor {
         this->showRadius = r;
         return {"Set the slime chunk to appear as " + std::to_string(r), true};
     }
+
+    ActionResult SlimeChunkHelper::startFind(Player *player, int range, int window) {
+        if (!player) return ErrorPlayerNeed();
+        if (this->finder.isRunning()) {
+            return {"A search is already running", false};
+        }
+        if (range <= 0 || range > MAX_FIND_RANGE) {
+            return {"Range should be in [1, " + std::to_string(MAX_FIND_RANGE) + "]", false};
+        }
+        if (window < 0 || window > MAX_FIND_WINDOW) {
+            return {"Window should be in [0, " + std::to_string(MAX_FIND_WINDOW) + "]", false};
+        }
+        auto center = fromBlockPos(player->getPos().toBlockPos()).toChunkPos();
+        auto threads = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 2u) - 1,
+                                        SlimeClusterFinder::MAX_WORKERS);
+        this->finder.start(center.x - range, center.z - range, range * 2, range * 2, window,
+                           threads);
+        this->finderRequester = player->getRealName();
+        return {"Searching " + std::to_string(range * 2) + "x" + std::to_string(range * 2) +
+                    " chunks with " + std::to_string(threads) + " threads",
+                true};
+    }
+
+    ActionResult SlimeChunkHelper::printFindStatus() const {
+        if (!this->finder.isRunning()) return {"No search is running", true};
+        TextBuilder b;
+        b.text("Searching: ").num(this->finder.progress() * 100.0).text("%%");
+        return {b.get(), true};
+    }
+
+    ActionResult SlimeChunkHelper::cancelFind() {
+        if (!this->finder.isRunning()) return {"No search is running", false};
+        this->finder.cancel();
+        return {"Search cancelled", true};
+    }
+
+    // 工作线程只负责置完成标记，结果在游戏线程里取走并发送
+    void SlimeChunkHelper::deliverFinderResult() {
+        auto results = this->finder.takeResults();
+        auto side = this->finder.getWindow() * 2 + 1;
+        TextBuilder b;
+        b.sTextF(TB::BOLD | TB::WHITE, "-- Top slime chunk windows (%dx%d) --\n", side, side);
+        for (auto &c : results) {
+            b.sText(TB::GRAY, " - ")
+                .textF("[%d, %d] (%d %d):  ", c.x, c.z, c.x * 16 + 8, c.z * 16 + 8)
+                .sTextF(TB::GREEN, "%d\n", c.count);
+        }
+        auto *player = Global<Level>->getPlayer(this->finderRequester);
+        if (player) {
+            player->sendText(b.get());
+        } else {
+            b.broadcast();
+        }
+    }
 }  // namespace trapdoor
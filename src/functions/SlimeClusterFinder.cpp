@@ -0,0 +1,166 @@
+#include "SlimeClusterFinder.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+#include "SlimeKernel.h"
+
+namespace trapdoor {
+    namespace {
+        // 每个线程保留的候选数量，多留一些给最后合并各线程结果时去重
+        constexpr size_t CANDIDATES_PER_WORKER = SlimeClusterFinder::TOP_K * 16;
+
+        inline bool better(const SlimeCluster &a, const SlimeCluster &b) {
+            if (a.count != b.count) return a.count > b.count;
+            if (a.z != b.z) return a.z < b.z;
+            return a.x < b.x;
+        }
+
+        inline bool overlap(const SlimeCluster &a, const SlimeCluster &b, int window) {
+            return std::abs(a.x - b.x) <= 2 * window && std::abs(a.z - b.z) <= 2 * window;
+        }
+
+        // 小顶堆：堆顶是当前候选里最差的
+        // 插入时就去掉重叠的窗口，否则一个密集的热点附近的窗口会占满整个堆
+        void pushCandidate(std::vector<SlimeCluster> &heap, const SlimeCluster &c, int window) {
+            if (heap.size() >= CANDIDATES_PER_WORKER && !better(c, heap.front())) return;
+            for (auto &e : heap) {
+                if (overlap(e, c, window) && !better(c, e)) return;
+            }
+            auto it = std::remove_if(heap.begin(), heap.end(), [&](const SlimeCluster &e) {
+                return overlap(e, c, window);
+            });
+            if (it != heap.end()) {
+                heap.erase(it, heap.end());
+                std::make_heap(heap.begin(), heap.end(), better);
+            }
+            if (heap.size() < CANDIDATES_PER_WORKER) {
+                heap.push_back(c);
+                std::push_heap(heap.begin(), heap.end(), better);
+            } else {
+                std::pop_heap(heap.begin(), heap.end(), better);
+                heap.back() = c;
+                std::push_heap(heap.begin(), heap.end(), better);
+            }
+        }
+    }  // namespace
+
+    SlimeClusterFinder::~SlimeClusterFinder() { this->cancel(); }
+
+    void SlimeClusterFinder::join() {
+        for (auto &t : this->workers) {
+            if (t.joinable()) t.join();
+        }
+        this->workers.clear();
+    }
+
+    bool SlimeClusterFinder::start(int x, int z, int w, int h, int win, size_t threads) {
+        if (this->running || w <= 0 || h <= 0 || win < 0) return false;
+        this->join();
+        this->minX = x, this->minZ = z, this->width = w, this->height = h, this->window = win;
+        this->nextStrip = 0;
+        this->rowsDone = 0;
+        this->stop = false;
+        this->finished = false;
+        this->candidates.clear();
+        this->running = true;
+        threads = std::max<size_t>(threads, 1);
+        this->activeWorkers = threads;
+        for (size_t i = 0; i < threads; i++) {
+            this->workers.emplace_back(&SlimeClusterFinder::work, this);
+        }
+        return true;
+    }
+
+    void SlimeClusterFinder::cancel() {
+        this->stop = true;
+        this->join();
+        this->running = false;
+        this->finished = false;
+    }
+
+    double SlimeClusterFinder::progress() const {
+        if (this->height <= 0) return 0;
+        return static_cast<double>(this->rowsDone.load()) / static_cast<double>(this->height);
+    }
+
+    void SlimeClusterFinder::work() {
+        std::vector<SlimeCluster> heap;
+        const int strips = (this->height + STRIP_ROWS - 1) / STRIP_ROWS;
+        while (!this->stop) {
+            auto strip = this->nextStrip.fetch_add(1);
+            if (strip >= strips) break;
+            this->scanStrip(strip, heap);
+        }
+        {
+            std::lock_guard<std::mutex> guard(this->resultLock);
+            this->candidates.insert(this->candidates.end(), heap.begin(), heap.end());
+        }
+        // 最后一个退出的线程负责标记完成
+        if (this->activeWorkers.fetch_sub(1) == 1 && !this->stop) {
+            this->finished = true;
+        }
+    }
+
+    // 竖直方向维护每一列在窗口高度内的史莱姆区块数，水平方向再做一次滑动求和
+    void SlimeClusterFinder::scanStrip(int strip, std::vector<SlimeCluster> &heap) {
+        const int w = this->window;
+        const int z0 = this->minZ + strip * STRIP_ROWS;
+        const int z1 = std::min(z0 + STRIP_ROWS, this->minZ + this->height);
+        const int x0 = this->minX - w;
+        const size_t cols = static_cast<size_t>(this->width) + 2 * w;
+        const size_t span = 2 * static_cast<size_t>(w) + 1;
+
+        std::vector<std::vector<uint8_t>> rows(span, std::vector<uint8_t>(cols));
+        std::vector<uint16_t> colSum(cols, 0);
+        auto rowOf = [&](int z) -> std::vector<uint8_t> & {
+            return rows[static_cast<size_t>(((z % static_cast<int>(span)) + span) % span)];
+        };
+
+        for (int z = z0 - w; z < z0 + w; z++) {
+            auto &row = rowOf(z);
+            slimeChunkRow(x0, z, cols, row.data());
+            for (size_t i = 0; i < cols; i++) colSum[i] += row[i];
+        }
+
+        for (int z = z0; z < z1 && !this->stop; z++) {
+            auto &incoming = rowOf(z + w);
+            slimeChunkRow(x0, z + w, cols, incoming.data());
+            for (size_t i = 0; i < cols; i++) colSum[i] += incoming[i];
+
+            int sum = 0;
+            for (size_t i = 0; i < span - 1; i++) sum += colSum[i];
+            for (int i = 0; i < this->width; i++) {
+                sum += colSum[i + span - 1];
+                pushCandidate(heap, {this->minX + i, z, sum}, w);
+                sum -= colSum[i];
+            }
+
+            auto &outgoing = rowOf(z - w);
+            for (size_t i = 0; i < cols; i++) colSum[i] -= outgoing[i];
+            ++this->rowsDone;
+        }
+    }
+
+    std::vector<SlimeCluster> SlimeClusterFinder::takeResults() {
+        this->join();
+        this->running = false;
+        this->finished = false;
+        std::vector<SlimeCluster> all;
+        {
+            std::lock_guard<std::mutex> guard(this->resultLock);
+            all.swap(this->candidates);
+        }
+        std::sort(all.begin(), all.end(), better);
+        std::vector<SlimeCluster> res;
+        for (auto &c : all) {
+            if (res.size() >= TOP_K) break;
+            bool overlapped = std::any_of(res.begin(), res.end(), [&](const SlimeCluster &r) {
+                return overlap(r, c, this->window);
+            });
+            if (!overlapped) res.push_back(c);
+        }
+        return res;
+    }
+}  // namespace trapdoor
@@ -0,0 +1,183 @@
+#include "SlimeKernel.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TRAPDOOR_SLIME_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define TRAPDOOR_SLIME_SSE2
+#endif
+
+namespace trapdoor {
+    namespace {
+        constexpr uint32_t MT_INIT_MUL = 1812433253u;
+        constexpr uint32_t MT_MATRIX_A = 0x9908b0dfu;
+        constexpr uint32_t MT_UPPER_MASK = 0x80000000u;
+        constexpr uint32_t MT_LOWER_MASK = 0x7fffffffu;
+        constexpr uint32_t MT_M = 397;
+
+        inline uint32_t temper(uint32_t y) {
+            y ^= y >> 11;
+            y ^= (y << 7) & 0x9d2c5680u;
+            y ^= (y << 15) & 0xefc60000u;
+            return y ^ (y >> 18);
+        }
+
+        inline uint32_t twistFirst(uint32_t m0, uint32_t m1, uint32_t m397) {
+            auto y = (m0 & MT_UPPER_MASK) | (m1 & MT_LOWER_MASK);
+            return temper(m397 ^ (y >> 1) ^ ((y & 1u) ? MT_MATRIX_A : 0u));
+        }
+
+#if defined(TRAPDOOR_SLIME_AVX2)
+        constexpr size_t LANES = 8;
+
+        void firstOutputs(const uint32_t *seeds, uint32_t *res) {
+            auto mul = _mm256_set1_epi32(static_cast<int>(MT_INIT_MUL));
+            auto m0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(seeds));
+            auto m = _mm256_add_epi32(
+                _mm256_mullo_epi32(mul, _mm256_xor_si256(m0, _mm256_srli_epi32(m0, 30))),
+                _mm256_set1_epi32(1));
+            auto m1 = m;
+            for (uint32_t i = 2; i <= MT_M; i++) {
+                m = _mm256_add_epi32(
+                    _mm256_mullo_epi32(mul, _mm256_xor_si256(m, _mm256_srli_epi32(m, 30))),
+                    _mm256_set1_epi32(static_cast<int>(i)));
+            }
+            alignas(32) uint32_t a0[LANES], a1[LANES], am[LANES];
+            _mm256_store_si256(reinterpret_cast<__m256i *>(a0), m0);
+            _mm256_store_si256(reinterpret_cast<__m256i *>(a1), m1);
+            _mm256_store_si256(reinterpret_cast<__m256i *>(am), m);
+            for (size_t l = 0; l < LANES; l++) res[l] = twistFirst(a0[l], a1[l], am[l]);
+        }
+
+        const char *KERNEL_NAME = "avx2";
+#elif defined(TRAPDOOR_SLIME_SSE2)
+        constexpr size_t LANES = 4;
+
+        // SSE2没有32位乘法的低位指令，用两次_mm_mul_epu32拼出来
+        inline __m128i mullo32(__m128i a, __m128i b) {
+            auto even = _mm_mul_epu32(a, b);
+            auto odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+            return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                      _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        }
+
+        void firstOutputs(const uint32_t *seeds, uint32_t *res) {
+            auto mul = _mm_set1_epi32(static_cast<int>(MT_INIT_MUL));
+            auto m0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(seeds));
+            auto m = _mm_add_epi32(mullo32(mul, _mm_xor_si128(m0, _mm_srli_epi32(m0, 30))),
+                                   _mm_set1_epi32(1));
+            auto m1 = m;
+            for (uint32_t i = 2; i <= MT_M; i++) {
+                m = _mm_add_epi32(mullo32(mul, _mm_xor_si128(m, _mm_srli_epi32(m, 30))),
+                                  _mm_set1_epi32(static_cast<int>(i)));
+            }
+            alignas(16) uint32_t a0[LANES], a1[LANES], am[LANES];
+            _mm_store_si128(reinterpret_cast<__m128i *>(a0), m0);
+            _mm_store_si128(reinterpret_cast<__m128i *>(a1), m1);
+            _mm_store_si128(reinterpret_cast<__m128i *>(am), m);
+            for (size_t l = 0; l < LANES; l++) res[l] = twistFirst(a0[l], a1[l], am[l]);
+        }
+
+        const char *KERNEL_NAME = "sse2";
+#else
+        constexpr size_t LANES = 8;
+
+        // 没有SIMD时按结构数组组织，交给编译器自动向量化
+        void firstOutputs(const uint32_t *seeds, uint32_t *res) {
+            uint32_t m1[LANES], m[LANES];
+            for (size_t l = 0; l < LANES; l++) {
+                m1[l] = MT_INIT_MUL * (seeds[l] ^ (seeds[l] >> 30)) + 1u;
+                m[l] = m1[l];
+            }
+            for (uint32_t i = 2; i <= MT_M; i++) {
+                for (size_t l = 0; l < LANES; l++) m[l] = MT_INIT_MUL * (m[l] ^ (m[l] >> 30)) + i;
+            }
+            for (size_t l = 0; l < LANES; l++) res[l] = twistFirst(seeds[l], m1[l], m[l]);
+        }
+
+        const char *KERNEL_NAME = "scalar";
+#endif
+    }  // namespace
+
+    uint32_t mt19937FirstOutput(uint32_t seed) {
+        auto m1 = MT_INIT_MUL * (seed ^ (seed >> 30)) + 1u;
+        auto m = m1;
+        for (uint32_t i = 2; i <= MT_M; i++) m = MT_INIT_MUL * (m ^ (m >> 30)) + i;
+        return twistFirst(seed, m1, m);
+    }
+
+    void slimeChunkRow(int x0, int z, size_t count, uint8_t *out) {
+        uint32_t seeds[LANES], res[LANES];
+        size_t i = 0;
+        for (; i + LANES <= count; i += LANES) {
+            for (size_t l = 0; l < LANES; l++) {
+                seeds[l] = slimeSeed(x0 + static_cast<int>(i + l), z);
+            }
+            firstOutputs(seeds, res);
+            for (size_t l = 0; l < LANES; l++) out[i + l] = res[l] % 10 == 0;
+        }
+        for (; i < count; i++) out[i] = isSlimeChunk(x0 + static_cast<int>(i), z);
+    }
+
+    const char *slimeKernelName() { return KERNEL_NAME; }
+
+    size_t SlimeView::index(int x, int z) const {
+        const int side = this->radius * 2;
+        auto ix = ((x % side) + side) % side;
+        auto iz = ((z % side) + side) % side;
+        return static_cast<size_t>(iz) * side + ix;
+    }
+
+    bool SlimeView::get(int x, int z) const {
+        auto i = this->index(x, z);
+        return (this->bits[i >> 6] >> (i & 63)) & 1u;
+    }
+
+    void SlimeView::set(int x, int z, bool v) {
+        auto i = this->index(x, z);
+        if (v) {
+            this->bits[i >> 6] |= uint64_t(1) << (i & 63);
+        } else {
+            this->bits[i >> 6] &= ~(uint64_t(1) << (i & 63));
+        }
+    }
+
+    void SlimeView::fillRow(int z, int x0, int x1) {
+        if (x1 <= x0) return;
+        std::vector<uint8_t> row(static_cast<size_t>(x1 - x0));
+        slimeChunkRow(x0, z, row.size(), row.data());
+        for (int x = x0; x < x1; x++) this->set(x, z, row[x - x0] != 0);
+    }
+
+    bool SlimeView::moveTo(int ncx, int ncz, int r) {
+        if (r <= 0) return false;
+        const int side = r * 2;
+        const bool rebuild = r != this->radius || std::abs(ncx - this->cx) >= side ||
+                             std::abs(ncz - this->cz) >= side;
+        if (!rebuild && ncx == this->cx && ncz == this->cz) return false;
+        const int ox0 = this->cx - this->radius, oz0 = this->cz - this->radius;
+        this->cx = ncx, this->cz = ncz;
+        const int x0 = ncx - r, x1 = ncx + r, z0 = ncz - r, z1 = ncz + r;
+        if (rebuild) {
+            this->radius = r;
+            this->bits.assign((static_cast<size_t>(side) * side + 63) / 64, 0);
+            for (int z = z0; z < z1; z++) this->fillRow(z, x0, x1);
+            return true;
+        }
+        // 旧窗口之外的行整行重算，剩下的行只补新进入的列
+        const int ox1 = ox0 + side, oz1 = oz0 + side;
+        for (int z = z0; z < z1; z++) {
+            if (z < oz0 || z >= oz1) {
+                this->fillRow(z, x0, x1);
+            } else {
+                this->fillRow(z, x0, std::min(x1, ox0));
+                this->fillRow(z, std::max(x0, ox1), x1);
+            }
+        }
+        return true;
+    }
+}  // namespace trapdoor
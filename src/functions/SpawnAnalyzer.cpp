@@ -6,7 +6,10 @@
 
 #include <MC/ActorDefinitionIdentifier.hpp>
 #include <MC/BlockSource.hpp>
+#include <MC/Dimension.hpp>
 #include <MC/LevelChunk.hpp>
+#include <algorithm>
+#include <functional>
 
 #include "DataConverter.h"
 #include "HookAPI.h"
@@ -14,24 +17,163 @@
 #include "TrapdoorMod.h"
 #include "Utils.h"
 namespace trapdoor {
-    void SpawnAnalyzer::AddMob(Mob * mob, const string &name, bool surface) {
+    namespace {
+        inline void addAt(std::vector<size_t> &v, size_t i, size_t n) {
+            if (v.size() <= i) v.resize(i + 1, 0);
+            v[i] += n;
+        }
+
+        inline size_t valueAt(const std::vector<size_t> &v, size_t i) {
+            return i < v.size() ? v[i] : 0;
+        }
+
+        constexpr float MIN_PLAYER_DISTANCE2 = 24.0f * 24.0f;
+        constexpr size_t TOP_FAILED_CHUNKS = 5;
+
+        const char *rejectName(size_t reason) {
+            static const char *names[] = {"light", "space", "cap", "distance"};
+            return names[reason];
+        }
+
+        size_t dominantReject(const SpawnAttemptStats &stats) {
+            size_t res = 0;
+            for (size_t i = 1; i < stats.rejected.size(); i++) {
+                if (stats.rejected[i] > stats.rejected[res]) res = i;
+            }
+            return res;
+        }
+
+        void printAttempt(TextBuilder &b, const SpawnAttemptStats &stats) {
+            b.num(stats.attempts).text(" attempts, ");
+            b.num(static_cast<float>(stats.success) * 100.0f / static_cast<float>(stats.attempts))
+                .text("%% success");
+            if (stats.success < stats.attempts) {
+                auto reason = dominantReject(stats);
+                b.text(", mostly ").sText(TB::RED, rejectName(reason));
+            }
+            b.text("\n");
+        }
+
+        void printMobs(TextBuilder &b, const std::vector<size_t> &density,
+                       const std::vector<size_t> &spawned, size_t samples, float hour) {
+            auto &index = trapdoor::mod().getEntityIndex();
+            for (size_t type = 0; type < density.size(); type++) {
+                if (density[type] == 0) continue;
+                auto name = trapdoor::rmmc(index.typeName(static_cast<uint16_t>(type)));
+                if (name == "player") continue;
+                b.sText(TB::GRAY, " - ").textF("%s:  ", trapdoor::i18ActorName(name).c_str());
+                b.text("Density: ")
+                    .num(static_cast<float>(density[type]) / static_cast<float>(samples));
+                auto spawn = valueAt(spawned, type);
+                if (spawn == 0) {
+                    b.text("\n");
+                } else {
+                    b.text(" Spawn: ")
+                        .num(spawn)
+                        .text(", ")
+                        .num(static_cast<float>(spawn) / hour)
+                        .text("/h\n");
+                }
+            }
+        }
+    }  // namespace
+
+    bool SpawnAnalyzer::inWindow(int dim, int cx, int cz) const {
+        return dim == this->dimensionID && abs(cx - this->centerChunkPos.x) <= 4 &&
+               abs(cz - this->centerChunkPos.z) <= 4;
+    }
+
+    SpawnAttemptStats *SpawnAnalyzer::currentMob() {
+        if (!this->current.hasType) return nullptr;
+        if (this->mobAttempts.size() <= this->current.type) {
+            this->mobAttempts.resize(this->current.type + 1);
+        }
+        return &this->mobAttempts[this->current.type];
+    }
+
+    void SpawnAnalyzer::reject(SpawnReject reason) {
+        auto r = static_cast<size_t>(reason);
+        ++this->chunkAttempts[this->current.chunk].rejected[r];
+        auto *mob = this->currentMob();
+        if (mob) ++mob->rejected[r];
+    }
+
+    // 位置检查通过但是没有等到spawnMob就开始了下一次尝试，认为是被生物上限挡住了
+    void SpawnAnalyzer::onMobToSpawn(const void *mobData, int dim, int cx, int cz) {
+        if (!this->inAnalyzing || this->muted) return;
+        if (this->current.awaitingSpawn) this->reject(SpawnReject::Cap);
+        this->current.awaitingSpawn = false;
+        this->current.chunk = EntityIndex::chunkKey(cx, cz);
+        this->current.hasType = false;
+        if (!this->inWindow(dim, cx, cz)) return;
+        if (!mobData) {
+            // 没有任何生成规则满足条件，绝大多数情况是亮度
+            ++this->chunkAttempts[this->current.chunk].attempts;
+            this->reject(SpawnReject::Light);
+            return;
+        }
+        auto it = this->ruleTypes.find(mobData);
+        if (it == this->ruleTypes.end()) {
+            auto &name =
+                dAccess<ActorDefinitionIdentifier, 8>(const_cast<void *>(mobData)).getIdentifier();
+            auto &names = this->attemptMobNames;
+            auto nameIt = std::find(names.begin(), names.end(), name);
+            auto type = static_cast<uint16_t>(nameIt - names.begin());
+            if (nameIt == names.end()) names.push_back(name);
+            it = this->ruleTypes.emplace(mobData, type).first;
+        }
+        this->current.type = it->second;
+        this->current.hasType = true;
+    }
+
+    void SpawnAnalyzer::onPositionChecked(bool ok, bool nearPlayer, int dim, int cx, int cz) {
+        if (!this->inAnalyzing || this->muted) return;
+        if (this->current.awaitingSpawn) this->reject(SpawnReject::Cap);
+        this->current.awaitingSpawn = false;
+        if (!this->inWindow(dim, cx, cz)) return;
+        this->current.chunk = EntityIndex::chunkKey(cx, cz);
+        ++this->chunkAttempts[this->current.chunk].attempts;
+        auto *mob = this->currentMob();
+        if (mob) ++mob->attempts;
+        if (ok) {
+            this->current.awaitingSpawn = true;
+        } else {
+            this->reject(nearPlayer ? SpawnReject::Distance : SpawnReject::Space);
+        }
+    }
+
+    void SpawnAnalyzer::onMobSpawned(bool success) {
+        if (!this->inAnalyzing || this->muted || !this->current.awaitingSpawn) return;
+        this->current.awaitingSpawn = false;
+        if (!success) {
+            this->reject(SpawnReject::Cap);
+            return;
+        }
+        ++this->chunkAttempts[this->current.chunk].success;
+        auto *mob = this->currentMob();
+        if (mob) ++mob->success;
+    }
+
+    void SpawnAnalyzer::AddMob(Mob * mob, bool surface) {
         if (!inAnalyzing || !mob) return;
         auto dimension = mob->getDimensionId();
         if (dimension != dimensionID) return;
-        if (surface)
-            this->surfaceMobs[name]++;
-        else
-            this->caveMobs[name]++;
+        auto type = trapdoor::mod().getEntityIndex().internType(mob->getTypeName());
+        addAt(surface ? this->surfaceMobs : this->caveMobs, type, 1);
     }
 
-    ActionResult SpawnAnalyzer::start(int id, const TBlockPos2 &pos) {
+    ActionResult SpawnAnalyzer::start(int id, const TBlockPos2 &pos, int rate) {
         if (this->inAnalyzing) {
             return {"Already in analyzing", false};
         }
+        if (rate < 1) {
+            return {"Sampling rate should be positive", false};
+        }
         this->clear();
         this->inAnalyzing = true;
         this->dimensionID = id;
         this->centerChunkPos = pos;
+        this->samplingRate = rate;
         return {"Start analyzing,This may bring higher MSPT", true};
     }
     ActionResult SpawnAnalyzer::stop() {
@@ -43,75 +185,81 @@ namespace trapdoor {
     }
 
     void SpawnAnalyzer::collectDensityInfo() {
-        if (!this->inAnalyzing) return;
-        auto entities = Level::getAllEntities();
-        for (auto actor : entities) {
-            if (!actor || actor->getDimensionId() != this->dimensionID) continue;
-            auto actorCh = fromBlockPos(actor->getPos().toBlockPos()).toChunkPos();
-            auto name = actor->getTypeName();
-            if (abs(actorCh.x - this->centerChunkPos.x) <= 4 &&
-                abs(actorCh.z - this->centerChunkPos.z) <= 4) {
-                if (actor->isSurfaceMob()) {
-                    this->surfaceMobsPerTick[name]++;
-                } else {
-                    this->caveMobsPerTick[name]++;
-                }
-            }
-        }
+        ++this->sample_count;
+        trapdoor::mod().getEntityIndex().forEachInRange(
+            this->dimensionID, this->centerChunkPos.x, this->centerChunkPos.z, 4,
+            [this](uint16_t type, bool surface, uint32_t count) {
+                addAt(surface ? this->surfaceMobsPerSample : this->caveMobsPerSample, type, count);
+            });
     }
 
     void SpawnAnalyzer::tick() {
+        if (!this->inAnalyzing) return;
+        trapdoor::mod().getEntityIndex().use();
+        if (tick_count % this->samplingRate == 0) {
+            this->collectDensityInfo();
+        }
         ++tick_count;
-        this->collectDensityInfo();
     }
 
     ActionResult SpawnAnalyzer::printResult() const {
+        if (this->sample_count == 0) {
+            return {"No data", false};
+        }
         TextBuilder b;
         // b.textF("Total %d gt\n", this->tick_count)
         const float hour = static_cast<float>(tick_count) / 72000.0f;
         b.text("Total ").num(tick_count).text("gt (").num(hour).text("h)\n");
         b.sText(TB::GREEN | TB::BOLD, "Surface:\n");
-        for (auto &p : this->surfaceMobsPerTick) {
-            auto type = trapdoor::rmmc(p.first);
-            if (type == "player") continue;
-            b.sText(TB::GRAY, " - ").textF("%s:  ", trapdoor::i18ActorName(type).c_str());
-            b.text("Density: ").num(static_cast<float>(p.second) / static_cast<float>(tick_count));
-            auto iter = this->surfaceMobs.find(type);
-            if (iter == this->surfaceMobs.end()) {
-                b.text("\n");
-            } else {
-                b.text(" Spawn: ")
-                    .num(iter->second)
-                    .text(", ")
-                    .num(static_cast<float>(iter->second) / hour)
-                    .text("/h\n");
-            }
-        }
+        printMobs(b, this->surfaceMobsPerSample, this->surfaceMobs, this->sample_count, hour);
         b.sText(TB::RED | TB::BOLD, "Underground:\n");
-        for (auto &p : this->caveMobsPerTick) {
-            auto type = trapdoor::rmmc(p.first);
-            if (type == "player") continue;
-            b.sText(TB::GRAY, " - ").textF("%s:  ", trapdoor::i18ActorName(type).c_str());
-            b.text("Density: ").num(static_cast<float>(p.second) / static_cast<float>(tick_count));
-            auto iter = this->caveMobs.find(type);
-            if (iter == this->caveMobs.end()) {
-                b.text("\n");
-            } else {
-                b.text(" Spawn: ")
-                    .num(iter->second)
-                    .text(", ")
-                    .num(static_cast<float>(iter->second) / hour)
-                    .text("/h\n");
+        printMobs(b, this->caveMobsPerSample, this->caveMobs, this->sample_count, hour);
+
+        SpawnAttemptStats total;
+        std::vector<std::pair<uint32_t, uint64_t>> failed;
+        for (auto &kv : this->chunkAttempts) {
+            auto &stats = kv.second;
+            total.attempts += stats.attempts;
+            total.success += stats.success;
+            for (size_t i = 0; i < stats.rejected.size(); i++) {
+                total.rejected[i] += stats.rejected[i];
             }
+            failed.emplace_back(stats.attempts - stats.success, kv.first);
+        }
+        if (total.attempts == 0) return {b.get(), true};
+        b.sText(TB::YELLOW | TB::BOLD, "Attempts:\n").sText(TB::GRAY, " - ").text("All: ");
+        printAttempt(b, total);
+        for (size_t type = 0; type < this->mobAttempts.size(); type++) {
+            auto &stats = this->mobAttempts[type];
+            if (stats.attempts == 0) continue;
+            b.sText(TB::GRAY, " - ")
+                .textF("%s:  ",
+                       trapdoor::i18ActorName(trapdoor::rmmc(this->attemptMobNames[type])).c_str());
+            printAttempt(b, stats);
+        }
+        auto topN = std::min(TOP_FAILED_CHUNKS, failed.size());
+        std::partial_sort(failed.begin(), failed.begin() + topN, failed.end(),
+                          std::greater<std::pair<uint32_t, uint64_t>>());
+        b.sText(TB::YELLOW | TB::BOLD, "Most failed chunks:\n");
+        for (size_t i = 0; i < topN; i++) {
+            auto key = failed[i].second;
+            b.sText(TB::GRAY, " - ")
+                .textF("[%d, %d]:  ", static_cast<int>(static_cast<uint32_t>(key >> 32)),
+                       static_cast<int>(static_cast<uint32_t>(key & 0xffffffffu)));
+            printAttempt(b, this->chunkAttempts.at(key));
         }
         return {b.get(), true};
     }
     ActionResult SpawnAnalyzer::clear() {
         this->tick_count = 0;
+        this->sample_count = 0;
         this->surfaceMobs.clear();
         this->caveMobs.clear();
-        this->surfaceMobsPerTick.clear();
-        this->caveMobsPerTick.clear();
+        this->surfaceMobsPerSample.clear();
+        this->caveMobsPerSample.clear();
+        this->current = PendingAttempt();
+        this->chunkAttempts.clear();
+        this->mobAttempts.clear();
         return {"Cleared", true};
     }
 }  // namespace trapdoor
@@ -122,9 +270,38 @@ THook(Mob *,
       void *s, BlockSource &bs, ActorDefinitionIdentifier const &id, class Actor *actor,
       class Vec3 const &pos, bool natural, bool surface, bool fromSpawner) {
     auto res = original(s, bs, id, actor, pos, natural, surface, fromSpawner);
+    auto &analyzer = trapdoor::mod().getSpawnAnalyzer();
+    if (natural) analyzer.onMobSpawned(res != nullptr);
     if (res) {
-        trapdoor::mod().getSpawnAnalyzer().AddMob(res, id.getIdentifier(), surface);
+        analyzer.AddMob(res, surface);
+    }
+
+    return res;
+}
+
+THook(void *,
+      "?getMobToSpawn@Block@@QEBAPEBVMobSpawnerData@@AEBVSpawnConditions@@AEAVBlockSource@@@Z",
+      void *block, trapdoor::TSpawnConditions &cond, BlockSource &bs) {
+    auto res = original(block, cond, bs);
+    auto &analyzer = trapdoor::mod().getSpawnAnalyzer();
+    if (analyzer.isActive()) {
+        analyzer.onMobToSpawn(res, bs.getDimensionId(), cond.pos.x >> 4, cond.pos.z >> 4);
     }
+    return res;
+}
 
+THook(bool,
+      "?_isSpawnPositionOk@Spawner@@IEBA_NAEBVMobSpawnRules@@AEAVBlockSource@@AEBVBlockPos@@_N@Z",
+      void *spawner, void *rules, BlockSource &bs, const BlockPos &pos, bool b) {
+    auto res = original(spawner, rules, bs, pos, b);
+    auto &analyzer = trapdoor::mod().getSpawnAnalyzer();
+    if (!analyzer.isActive()) return res;
+    bool nearPlayer = false;
+    if (!res) {
+        Vec3 p(pos.x, pos.y, pos.z);
+        nearPlayer =
+            bs.getDimension().distanceToNearestPlayerSqr2D(p) < trapdoor::MIN_PLAYER_DISTANCE2;
+    }
+    analyzer.onPositionChecked(res, nearPlayer, bs.getDimensionId(), pos.x >> 4, pos.z >> 4);
     return res;
 }
@@ -9,12 +9,16 @@
 #include <MC/Level.hpp>
 #include <MC/Material.hpp>
 #include <MC/Spawner.hpp>
+#include <algorithm>
+#include <cmath>
 #include <unordered_map>
 
 #include "CommandHelper.h"
 #include "DataConverter.h"
 #include "HookAPI.h"
 #include "Msg.h"
+#include "Particle.h"
+#include "TrapdoorMod.h"
 #include "Utils.h"
 enum SpawnBlockRequirements;
 class SpawnConditions;
@@ -35,6 +39,19 @@ namespace trapdoor {
                 bool)(sp, rule, bs, pos, false);
         }
 
+        // 从建筑高度往下找出该柱子所有可刷怪的地面，第一个是地表
+        void collectSpawnFloors(BlockSource &bs, int x, int z, std::vector<BlockPos> &floors) {
+            BlockPos topPos = {x, 320, z};
+            int lastY = topPos.y;
+            while (topPos.y >= -64) {
+                Spawner::findNextSpawnBlockUnder(bs, topPos, static_cast<MaterialType>(52),
+                                                 (SpawnBlockRequirements)0);
+                if (lastY == topPos.y) break;
+                floors.push_back(topPos);
+                lastY = topPos.y;
+            }
+        }
+
         TSpawnConditions buildSpawnConditions(const BlockPos &pos, BlockSource &bs, bool surface) {
             auto &a1m = bs.getBlock(pos + BlockPos(0, 1, 0)).getMaterial();
             auto &a2m = bs.getBlock(pos + BlockPos(0, 2, 0)).getMaterial();
@@ -53,6 +70,101 @@ namespace trapdoor {
             cond.pos = pos + BlockPos(0, 1, 0);
             return cond;
         }
+
+        // 自适应的刷怪概率采样，每批采样后计算各生物95%置信区间的半宽，足够稳定就停止
+        class SpawnProbEstimator {
+           public:
+            static constexpr int BATCH = 100;
+            static constexpr int MIN_SAMPLES = 200;
+            static constexpr int MAX_SAMPLES = 5000;
+            static constexpr double TARGET_HALF_WIDTH = 0.02;
+
+            struct MobEntry {
+                std::string name;
+                int count = 0;
+                bool ok = false;
+            };
+
+            // 返回false表示该位置没有可生成的生物
+            bool run(Player *player, const BlockPos &topPos, TSpawnConditions &cond) {
+                auto &bs = player->getRegion();
+                auto &block = bs.getBlock(topPos);
+                auto *spawner = &player->getLevel().getSpawner();
+                while (this->total < MAX_SAMPLES) {
+                    for (int i = 0; i < BATCH; i++) {
+                        auto *mobData =
+                            block.getMobToSpawn(*reinterpret_cast<SpawnConditions *>(&cond), bs);
+                        if (!mobData) return false;
+                        this->add(mobData, spawner, bs, topPos);
+                    }
+                    if (this->total >= MIN_SAMPLES && this->maxHalfWidth() <= TARGET_HALF_WIDTH) {
+                        break;
+                    }
+                }
+                return true;
+            }
+
+            inline double ratio(const MobEntry &e) const {
+                return static_cast<double>(e.count) / static_cast<double>(total);
+            }
+
+            inline double halfWidth(const MobEntry &e) const {
+                auto p = ratio(e);
+                return 1.96 * std::sqrt(p * (1 - p) / static_cast<double>(total));
+            }
+
+            std::vector<MobEntry> mobs;
+            int total = 0;
+
+           private:
+            // 按生成规则指针驻留，同一规则每次采样只需一次指针查找
+            template <typename T>
+            void add(T *mobData, Spawner *spawner, BlockSource &bs, const BlockPos &topPos) {
+                ++this->total;
+                auto it = this->slots.find(mobData);
+                if (it != this->slots.end()) {
+                    ++this->mobs[it->second].count;
+                    return;
+                }
+                auto &id = dAccess<ActorDefinitionIdentifier, 8>(mobData);
+                const auto &name = id.getIdentifier();
+                size_t slot = 0;
+                while (slot < this->mobs.size() && this->mobs[slot].name != name) ++slot;
+                if (slot == this->mobs.size()) {
+                    MobEntry e;
+                    e.name = name;
+                    e.ok = isSpawnConditionsOK(spawner, &dAccess<TMobSpawnRules, 184>(mobData),
+                                               bs, topPos + BlockPos(0, 1, 0));
+                    this->mobs.push_back(e);
+                }
+                this->slots[mobData] = slot;
+                ++this->mobs[slot].count;
+            }
+
+            double maxHalfWidth() const {
+                double res = 0;
+                for (auto &e : this->mobs) res = std::max(res, halfWidth(e));
+                return res;
+            }
+
+            std::unordered_map<const void *, size_t> slots;
+        };
+
+        constexpr int HEATMAP_MOB_SAMPLES = 8;
+        constexpr int HEATMAP_CHUNKS_PER_TICK = 2;
+        constexpr int HEATMAP_MAX_RADIUS = 4;
+        constexpr int HEATMAP_MAX_CHUNKS = 81;
+        constexpr size_t HEATMAP_MAX_PARTICLES = 4096;
+        constexpr uint64_t HEATMAP_CACHE_TIMEOUT = 1200;
+
+        inline uint64_t chunkKey(int cx, int cz) {
+            return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) |
+                   static_cast<uint32_t>(cz);
+        }
+
+        inline int floorDiv16(int v) { return v >> 4; }
+
+        uint64_t currentTick() { return Global<Level>->getCurrentServerTick().t; }
     }  // namespace
 
     ActionResult printCap(const ActorDefinitionIdentifier *id) {
@@ -64,30 +176,29 @@ namespace trapdoor {
         return {id->getFullName() + " ==> " + std::to_string(pool), true};
     }
 
+    // 计数直接从EntityIndex读取，chunk/density/all分别只访问1、81个区块和维度总数
+    // 索引没有启用时先扫描一遍所有实体，结果和直接遍历getAllEntities一致
     ActionResult countActors(Player * player, const std::string &type) {
+        if (!player) return ErrorPlayerNeed();
         auto chPos = fromBlockPos(player->getPos().toBlockPos()).toChunkPos();
-        auto entities = Level::getAllEntities();
-        std::unordered_map<std::string, size_t> chunkList, allList, densityList;
-        for (auto actor : entities) {
-            if (!actor || actor->getDimensionId() != player->getDimensionId()) continue;
-            auto actorCh = fromBlockPos(actor->getPos().toBlockPos()).toChunkPos();
-            auto name = actor->getTypeName();
-            allList[name]++;
-            if (actorCh == chPos) {
-                chunkList[name]++;
-            }
-            if (abs(actorCh.x - chPos.x) <= 4 && abs(actorCh.z - chPos.z) <= 4) {
-                densityList[name]++;
-            }
+        auto dim = static_cast<int>(player->getDimensionId());
+        auto &index = trapdoor::mod().getEntityIndex();
+        index.use();
+        std::vector<size_t> res;
+        if (type == "chunk") {
+            res = index.countInRange(dim, chPos.x, chPos.z, 0);
+        } else if (type == "density") {
+            res = index.countInRange(dim, chPos.x, chPos.z, 4);
+        } else {
+            res = index.countAll(dim);
         }
-        auto &res = allList;
-        if (type == "chunk") res = chunkList;
-        if (type == "density") res = densityList;
         TextBuilder builder;
-        for (auto &i : res) {
+        for (size_t i = 0; i < res.size(); i++) {
+            if (res[i] == 0) continue;
             builder.sText(TB::GRAY, " - ")
-                .textF("%s: ", trapdoor::i18ActorName(i.first).c_str())
-                .num(i.second)
+                .textF("%s: ",
+                       trapdoor::i18ActorName(index.typeName(static_cast<uint16_t>(i))).c_str())
+                .num(res[i])
                 .text("\n");
         }
         return {builder.get(), true};
@@ -115,59 +226,28 @@ namespace trapdoor {
     }
 
     ActionResult printSpawnProbability(Player * player, const BlockPos &pos) {
-        BlockPos topPos = {pos.x, 320, pos.z};
-        bool isSurface = true;
-        bool hasFound = false;
-        int lastY = topPos.y;
-        while (topPos.y >= -64) {
-            Spawner::findNextSpawnBlockUnder(player->getRegion(), topPos,
-                                             static_cast<MaterialType>(52),
-                                             (SpawnBlockRequirements)0);
-            if (topPos.y == pos.y) {
-                hasFound = true;
-                break;
-            }
-            isSurface = false;
-            if (lastY == topPos.y) {
-                break;
-            } else {
-                lastY = topPos.y;
-            }
-        }
-        if (!hasFound) {
+        std::vector<BlockPos> floors;
+        collectSpawnFloors(player->getRegion(), pos.x, pos.z, floors);
+        auto it = std::find_if(floors.begin(), floors.end(),
+                               [&pos](const BlockPos &p) { return p.y == pos.y; });
+        if (it == floors.end()) {
             return {"No position", true};
         }
+        auto topPos = *it;
+        bool isSurface = it == floors.begin();
 
         auto cond = buildSpawnConditions(topPos, player->getRegion(), isSurface);
 
         trapdoor::logger().debug("surf/under:{}/{} water/lava:{}/{}  bright:{}", cond.isOnSurface,
                                  cond.isUnderground, cond.isInWater, cond.isInLava,
                                  cond.rawBrightness);
-        auto &block = player->getRegion().getBlock(topPos);
-        std::map<std::string, std::pair<int, bool>> spawnMap;
-        for (int i = 0; i < 1000; i++) {
-            auto *mobData = block.getMobToSpawn(*reinterpret_cast<SpawnConditions *>(&cond),
-                                                player->getRegion());
-            if (!mobData) {
-                return {"No mob to spawn", true};
-            }
-            auto &id = dAccess<ActorDefinitionIdentifier, 8>(mobData);
-            auto iter = spawnMap.find(id.getIdentifier());
-            if (iter == spawnMap.end()) {
-                auto ok = isSpawnConditionsOK(&player->getLevel().getSpawner(),
-                                              &dAccess<TMobSpawnRules, 184>(mobData),
-                                              player->getRegion(), topPos + BlockPos(0, 1, 0));
-                spawnMap[id.getIdentifier()] = {1, ok};
-            } else {
-                auto ct = iter->second.first;
-                auto ok = iter->second.second;
-                spawnMap[id.getIdentifier()] = {ct + 1, ok};
-            }
-        }
-
-        int totalCount = 0;
-        for (const auto &mob : spawnMap) {
-            totalCount += mob.second.first;
+        SpawnProbEstimator estimator;
+        auto &analyzer = trapdoor::mod().getSpawnAnalyzer();
+        analyzer.mute(true);
+        auto hasMob = estimator.run(player, topPos, cond);
+        analyzer.mute(false);
+        if (!hasMob) {
+            return {"No mob to spawn", true};
         }
 
         TextBuilder builder;
@@ -179,17 +259,380 @@ namespace trapdoor {
             .text(" - Surface / Underground: ")
             .sTextF(TextBuilder::GREEN, "%d / %d\n", cond.isOnSurface, cond.isUnderground)
             .text(" - Water / Lava: ")
-            .sTextF(TextBuilder::GREEN, "%d / %d\n\n", cond.isInWater, cond.isInLava);
+            .sTextF(TextBuilder::GREEN, "%d / %d\n", cond.isInWater, cond.isInLava);
+        auto *hsa = trapdoor::mod().getHsaManager().find(static_cast<int>(player->getDimensionId()),
+                                                         fromBlockPos(topPos + BlockPos(0, 1, 0)));
+        if (hsa) {
+            builder.text(" - HSA: ").sTextF(TextBuilder::GREEN, "%s\n", structureName(hsa->type));
+        }
+        builder.text(" - Samples: ")
+            .sTextF(TextBuilder::GREEN, "%d\n\n", estimator.total);
 
-        for (const auto &mob : spawnMap) {
-            auto ok = mob.second.second;
-            auto color = ok ? TB::DARK_GREEN : TB::DARK_RED;
+        for (const auto &mob : estimator.mobs) {
+            auto color = mob.ok ? TB::DARK_GREEN : TB::DARK_RED;
             builder.sText(TB::GRAY, " - ")
-                .textF("%s:  ", trapdoor::i18ActorName(mob.first).c_str())
-                .num(mob.second.first * 100.0 / totalCount)
+                .textF("%s:  ", trapdoor::i18ActorName(mob.name).c_str())
+                .num(estimator.ratio(mob) * 100.0)
+                .textF(" ± %.1f", estimator.halfWidth(mob) * 100.0)
                 .text("%%, Can: ")
-                .sTextF(color | TB::BOLD, "%d\n", ok);
+                .sTextF(color | TB::BOLD, "%d\n", mob.ok);
         }
         return {builder.get(), true};
     }
-}  // namespace trapdoor
\ No newline at end of file
+
+    uint8_t SpawnHelper::internMob(const std::string &name) {
+        auto it = this->mobIds.find(name);
+        if (it != this->mobIds.end()) return it->second;
+        if (this->mobNames.size() >= 0xff) return 0xff;
+        auto id = static_cast<uint8_t>(this->mobNames.size());
+        this->mobNames.push_back(name);
+        this->mobIds[name] = id;
+        return id;
+    }
+
+    void SpawnHelper::computeChunk(int cx, int cz, SpawnChunkColumns &res) {
+        res.computedAt = currentTick();
+        auto *bs = Level::getBlockSource(this->dimensionID);
+        if (!bs) return;
+        auto *spawner = &Global<Level>->getSpawner();
+        std::vector<BlockPos> floors;
+        std::unordered_map<const void *, bool> okCache;
+        std::array<int, 0x100> votes{};
+        for (int dx = 0; dx < 16; dx++) {
+            for (int dz = 0; dz < 16; dz++) {
+                auto &column = res.columns[dx * 16 + dz];
+                column.clear();
+                floors.clear();
+                collectSpawnFloors(*bs, cx * 16 + dx, cz * 16 + dz, floors);
+                for (size_t i = 0; i < floors.size(); i++) {
+                    auto &floorPos = floors[i];
+                    auto cond = buildSpawnConditions(floorPos, *bs, i == 0);
+                    SpawnFloor floor;
+                    floor.y = static_cast<int16_t>(floorPos.y);
+                    floor.brightness = static_cast<uint8_t>(std::min(cond.rawBrightness, 15u));
+                    floor.surface = i == 0;
+
+                    // 同一地面上每种生成规则只做一次位置检查
+                    okCache.clear();
+                    votes.fill(0);
+                    auto &block = bs->getBlock(floorPos);
+                    for (int s = 0; s < HEATMAP_MOB_SAMPLES; s++) {
+                        auto *mobData =
+                            block.getMobToSpawn(*reinterpret_cast<SpawnConditions *>(&cond), *bs);
+                        if (!mobData) break;
+                        auto iter = okCache.find(mobData);
+                        if (iter == okCache.end()) {
+                            auto ok = isSpawnConditionsOK(spawner,
+                                                          &dAccess<TMobSpawnRules, 184>(mobData),
+                                                          *bs, floorPos + BlockPos(0, 1, 0));
+                            iter = okCache.emplace(mobData, ok).first;
+                        }
+                        if (floor.state == SpawnFloorState::Safe) {
+                            floor.state = SpawnFloorState::Blocked;
+                        }
+                        if (!iter->second) continue;
+                        floor.state = SpawnFloorState::Spawnable;
+                        auto id = this->internMob(
+                            dAccess<ActorDefinitionIdentifier, 8>(mobData).getIdentifier());
+                        if (++votes[id] > (floor.mob == 0xff ? 0 : votes[floor.mob])) {
+                            floor.mob = id;
+                        }
+                    }
+                    column.push_back(floor);
+                }
+            }
+        }
+    }
+
+    void SpawnHelper::select(int dim, int x0, int y0, int z0, int x1, int y1, int z1) {
+        this->enable = true;
+        this->dimensionID = dim;
+        this->minX = std::min(x0, x1), this->maxX = std::max(x0, x1);
+        this->minY = std::min(y0, y1), this->maxY = std::max(y0, y1);
+        this->minZ = std::min(z0, z1), this->maxZ = std::max(z0, z1);
+        this->pending.clear();
+        this->queueStaleChunks();
+    }
+
+    void SpawnHelper::queueStaleChunks() {
+        auto gt = currentTick();
+        auto &chunks = this->cache[this->dimensionID];
+        for (int cx = floorDiv16(this->minX); cx <= floorDiv16(this->maxX); cx++) {
+            for (int cz = floorDiv16(this->minZ); cz <= floorDiv16(this->maxZ); cz++) {
+                auto key = chunkKey(cx, cz);
+                auto it = chunks.find(key);
+                if (it == chunks.end() || gt - it->second.computedAt > HEATMAP_CACHE_TIMEOUT) {
+                    this->pending.push_back(key);
+                }
+            }
+        }
+    }
+
+    ActionResult SpawnHelper::showChunkRadius(Player *player, int radius) {
+        if (!player) return ErrorPlayerNeed();
+        if (radius < 0 || radius > HEATMAP_MAX_RADIUS) {
+            return {"Radius should be in [0, " + std::to_string(HEATMAP_MAX_RADIUS) + "]", false};
+        }
+        auto ch = fromBlockPos(player->getPos().toBlockPos()).toChunkPos();
+        this->select(player->getDimensionId(), (ch.x - radius) * 16, -64, (ch.z - radius) * 16,
+                     (ch.x + radius) * 16 + 15, 320, (ch.z + radius) * 16 + 15);
+        return {"~", true};
+    }
+
+    ActionResult SpawnHelper::showArea(Player *player, const BlockPos &from, const BlockPos &to) {
+        if (!player) return ErrorPlayerNeed();
+        auto chunks = (std::abs(floorDiv16(from.x) - floorDiv16(to.x)) + 1) *
+                      (std::abs(floorDiv16(from.z) - floorDiv16(to.z)) + 1);
+        if (chunks > HEATMAP_MAX_CHUNKS) {
+            return {"Area is too large", false};
+        }
+        this->select(player->getDimensionId(), from.x, from.y, from.z, to.x, to.y, to.z);
+        return {"~", true};
+    }
+
+    ActionResult SpawnHelper::clear() {
+        this->enable = false;
+        this->pending.clear();
+        for (auto &chunks : this->cache) chunks.clear();
+        return {"~", true};
+    }
+
+    ActionResult SpawnHelper::printInfo() {
+        if (!this->enable) return {"Heatmap is not enabled", false};
+        size_t total = 0, spawnable = 0, blocked = 0;
+        // 按亮度统计会刷怪和被挡住的地面数量，方便判断补光位置
+        std::array<std::pair<size_t, size_t>, 16> lightCount{};
+        std::vector<size_t> mobCount(this->mobNames.size(), 0);
+        auto &chunks = this->cache[this->dimensionID];
+        for (int x = this->minX; x <= this->maxX; x++) {
+            for (int z = this->minZ; z <= this->maxZ; z++) {
+                auto it = chunks.find(chunkKey(floorDiv16(x), floorDiv16(z)));
+                if (it == chunks.end()) continue;
+                for (auto &floor : it->second.columns[(x & 15) * 16 + (z & 15)]) {
+                    if (floor.y < this->minY || floor.y > this->maxY) continue;
+                    ++total;
+                    if (floor.state == SpawnFloorState::Blocked) {
+                        ++blocked;
+                        ++lightCount[floor.brightness].second;
+                    }
+                    if (floor.state != SpawnFloorState::Spawnable) continue;
+                    ++spawnable;
+                    ++lightCount[floor.brightness].first;
+                    if (floor.mob < mobCount.size()) ++mobCount[floor.mob];
+                }
+            }
+        }
+
+        TextBuilder builder;
+        builder
+            .sTextF(TB::BOLD | TB::WHITE, "-- [%d %d %d] ~ [%d %d %d] --\n", this->minX,
+                    this->minY, this->minZ, this->maxX, this->maxY, this->maxZ)
+            .text(" - Pending chunks: ")
+            .sTextF(TB::GREEN, "%zu\n", this->pending.size())
+            .text(" - Floors: ")
+            .sTextF(TB::GREEN, "%zu\n", total)
+            .text(" - Spawnable / Blocked: ")
+            .sTextF(TB::RED, "%zu", spawnable)
+            .text(" / ")
+            .sTextF(TB::YELLOW, "%zu\n", blocked);
+        for (size_t i = 0; i < lightCount.size(); i++) {
+            auto &c = lightCount[i];
+            if (c.first == 0 && c.second == 0) continue;
+            builder.sText(TB::GRAY, " - ")
+                .textF("Light %zu:  ", i)
+                .sTextF(TB::RED, "%zu", c.first)
+                .text(" / ")
+                .sTextF(TB::YELLOW, "%zu\n", c.second);
+        }
+        for (size_t i = 0; i < mobCount.size(); i++) {
+            if (mobCount[i] == 0) continue;
+            builder.sText(TB::GRAY, " - ")
+                .textF("%s:  ", trapdoor::i18ActorName(this->mobNames[i]).c_str())
+                .num(mobCount[i])
+                .text("\n");
+        }
+        return {builder.get(), true};
+    }
+
+    void SpawnHelper::lightTick() {
+        if (!this->enable) return;
+        // 队列清空后定期检查选区，过期的缓存重新计算
+        static int stale_time = 0;
+        stale_time = (stale_time + 1) % 100;
+        if (this->pending.empty() && stale_time == 0) this->queueStaleChunks();
+        auto &chunks = this->cache[this->dimensionID];
+        for (int i = 0; i < HEATMAP_CHUNKS_PER_TICK && !this->pending.empty(); i++) {
+            auto key = this->pending.front();
+            this->pending.pop_front();
+            auto cx = static_cast<int>(static_cast<uint32_t>(key >> 32));
+            auto cz = static_cast<int>(static_cast<uint32_t>(key & 0xffffffffu));
+            auto &analyzer = trapdoor::mod().getSpawnAnalyzer();
+            analyzer.mute(true);
+            this->computeChunk(cx, cz, chunks[key]);
+            analyzer.mute(false);
+        }
+    }
+
+    void SpawnHelper::heavyTick() {
+        if (!this->enable) return;
+        static int refresh_time = 0;
+        refresh_time = (refresh_time + 1) % 40;
+        if (refresh_time != 1) return;
+        this->draw();
+    }
+
+    // 只画会刷怪(红)和被挡住(黄)的地面，安全的地面不画
+    void SpawnHelper::draw() {
+        auto &chunks = this->cache[this->dimensionID];
+        size_t count = 0;
+        for (int x = this->minX; x <= this->maxX; x++) {
+            for (int z = this->minZ; z <= this->maxZ; z++) {
+                auto it = chunks.find(chunkKey(floorDiv16(x), floorDiv16(z)));
+                if (it == chunks.end()) continue;
+                for (auto &floor : it->second.columns[(x & 15) * 16 + (z & 15)]) {
+                    if (floor.y < this->minY || floor.y > this->maxY) continue;
+                    if (floor.state == SpawnFloorState::Safe) continue;
+                    if (++count > HEATMAP_MAX_PARTICLES) return;
+                    auto color =
+                        floor.state == SpawnFloorState::Spawnable ? PCOLOR::RED : PCOLOR::YELLOW;
+                    TVec3 p{static_cast<float>(x), static_cast<float>(floor.y) + 1.05f,
+                            static_cast<float>(z) + 0.5f};
+                    trapdoor::drawLine(p, TFACING::POS_X, 1.0f, color, this->dimensionID);
+                }
+            }
+        }
+    }
+
+    int MobCapMonitor::poolOf(uint16_t type) {
+        if (this->typePools.size() <= type) this->typePools.resize(type + 1, -2);
+        auto &pool = this->typePools[type];
+        if (pool != -2) return pool;
+        pool = -1;
+        auto &name = trapdoor::mod().getEntityIndex().typeName(type);
+        auto *g = getSpawnRuleGroup();
+        if (g && trapdoor::rmmc(name) != "player") {
+            pool = g->getActorSpawnPool(ActorDefinitionIdentifier(name));
+        }
+        if (pool >= 0) this->poolTypes[pool].push_back(type);
+        return pool;
+    }
+
+    void MobCapMonitor::sample(uint64_t gt) {
+        auto &index = trapdoor::mod().getEntityIndex();
+        for (int dim = 0; dim < 3; dim++) {
+            auto counts = index.countAll(dim);
+            auto &cur = this->current[dim];
+            for (auto &kv : cur) kv.second = 0;
+            for (size_t type = 0; type < counts.size(); type++) {
+                if (counts[type] == 0) continue;
+                auto pool = this->poolOf(static_cast<uint16_t>(type));
+                if (pool >= 0) cur[pool] += static_cast<uint32_t>(counts[type]);
+            }
+            for (auto &kv : cur) {
+                auto &ps = this->series[dim][kv.first];
+                if (ps.samples.empty()) ps.samples.resize(HISTORY, 0);
+                auto last = ps.count ? ps.samples[(ps.head + HISTORY - 1) % HISTORY] : 0;
+                ps.samples[ps.head] = kv.second;
+                ps.head = (ps.head + 1) % HISTORY;
+                ps.count = std::min(ps.count + 1, HISTORY);
+                ps.peak = std::max(ps.peak, kv.second);
+                auto cap = this->caps.find(kv.first);
+                if (cap != this->caps.end() && kv.second >= cap->second) {
+                    ++ps.cappedSamples;
+                    if (last < cap->second) ps.lastHit = gt;
+                }
+            }
+        }
+    }
+
+    void MobCapMonitor::tick() {
+        static int refresh_time = 0;
+        refresh_time = (refresh_time + 1) % SAMPLE_INTERVAL;
+        if (refresh_time != 1) return;
+        // 设置了上限时一直记录，否则只在索引被使用期间记录
+        auto &index = trapdoor::mod().getEntityIndex();
+        if (!this->caps.empty()) index.use();
+        if (!index.isActive()) return;
+        this->sample(currentTick());
+    }
+
+    ActionResult MobCapMonitor::setCap(int pool, int cap) {
+        if (cap <= 0) {
+            this->caps.erase(pool);
+        } else {
+            this->caps[pool] = static_cast<uint32_t>(cap);
+        }
+        for (auto &dimSeries : this->series) {
+            auto it = dimSeries.find(pool);
+            if (it == dimSeries.end()) continue;
+            it->second.cappedSamples = 0;
+            it->second.lastHit = 0;
+        }
+        return {"~", true};
+    }
+
+    std::string MobCapMonitor::poolLabel(int pool) const {
+        std::string label = std::to_string(pool);
+        auto it = this->poolTypes.find(pool);
+        if (it == this->poolTypes.end() || it->second.empty()) return label;
+        auto &index = trapdoor::mod().getEntityIndex();
+        label += " (";
+        for (size_t i = 0; i < it->second.size() && i < 2; i++) {
+            if (i) label += ", ";
+            label += trapdoor::i18ActorName(trapdoor::rmmc(index.typeName(it->second[i])));
+        }
+        if (it->second.size() > 2) label += "...";
+        return label + ")";
+    }
+
+    std::string MobCapMonitor::getHUDText(int dim) const {
+        trapdoor::mod().getEntityIndex().use();
+        if (dim < 0 || dim >= 3 || this->current[dim].empty()) return "";
+        TextBuilder b;
+        b.text("Cap:");
+        for (auto &kv : this->current[dim]) {
+            if (kv.second == 0) continue;
+            auto cap = this->caps.find(kv.first);
+            if (cap == this->caps.end()) {
+                b.textF(" [%d]%u", kv.first, kv.second);
+            } else {
+                auto color = kv.second >= cap->second ? TB::RED : TB::GREEN;
+                b.textF(" [%d]", kv.first).sTextF(color, "%u/%u", kv.second, cap->second);
+            }
+        }
+        b.text("\n");
+        return b.get();
+    }
+
+    ActionResult MobCapMonitor::printSummary(int dim) const {
+        trapdoor::mod().getEntityIndex().use();
+        if (dim < 0 || dim >= 3 || this->series[dim].empty()) {
+            return {"No data", false};
+        }
+        auto gt = currentTick();
+        TextBuilder b;
+        b.sTextF(TB::BOLD | TB::WHITE, "-- Spawn pools in dimension %d --\n", dim);
+        for (auto &kv : this->series[dim]) {
+            auto &ps = kv.second;
+            if (ps.count == 0) continue;
+            uint64_t sum = 0;
+            for (size_t i = 0; i < ps.count; i++) sum += ps.samples[i];
+            auto now = this->current[dim].at(kv.first);
+            b.sText(TB::GRAY, " - ").textF("%s: ", this->poolLabel(kv.first).c_str());
+            auto cap = this->caps.find(kv.first);
+            if (cap != this->caps.end()) {
+                auto color = now >= cap->second ? TB::RED : TB::GREEN;
+                b.sTextF(color, "%u / %u", now, cap->second);
+            } else {
+                b.sTextF(TB::GREEN, "%u", now);
+            }
+            b.textF("  avg %.1f  peak %u", static_cast<double>(sum) / ps.count, ps.peak);
+            if (cap != this->caps.end() && ps.cappedSamples > 0) {
+                b.textF("  capped %zu gt", ps.cappedSamples * SAMPLE_INTERVAL);
+                if (ps.lastHit) b.textF(", last hit %llu gt ago", gt - ps.lastHit);
+            }
+            b.text("\n");
+        }
+        return {b.get(), true};
+    }
+}  // namespace trapdoor
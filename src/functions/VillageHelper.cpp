@@ -11,7 +11,9 @@
 #include <MC/Vec3.hpp>
 #include <MC/Village.hpp>
 #include <MC/VillageManager.hpp>
+#include <algorithm>
 #include <array>
+#include <cstring>
 #include <unordered_set>
 
 #include "DataConverter.h"
@@ -53,61 +55,85 @@ namespace trapdoor {
             return {map[0].size(), map[1].size(), map[2].size(), map[3].size()};
         }
 
-        void Village_showHeadInfo(int vid, Village *v) {
-            auto map = Village_getDwellerPOIMap(v);
+        // UUID按原始的16字节比较，避免每gt格式化字符串
+        std::array<uint64_t, 2> Village_rawUUID(Village *v) {
+            static_assert(sizeof(mce::UUID) == 16);
+            const mce::UUID id = v->getUniqueID();
+            std::array<uint64_t, 2> raw{};
+            std::memcpy(raw.data(), &id, sizeof(raw));
+            return raw;
+        }
+
+        typedef std::unordered_map<ActorUniqueID, std::string, TActorUniqueIDHash> HeadInfoMap;
+
+        // 只生成头顶文本，不访问实体
+        void Village_collectHeadInfo(int vid, Village *v, HeadInfoMap &tags) {
+            const auto &map = Village_getDwellerPOIMap(v);
             int idx = 1;
             const char *icons[3] = {"B", "M", "J"};
-            for (auto &kv : map) {
-                auto actor = Global<Level>->fetchEntity(kv.first, false);
-                if (actor) {
-                    TextBuilder builder;
-                    builder.textF("[%d] %d ", vid, idx);
-                    ++idx;
-                    for (int index = 0; index < 3; ++index) {
-                        auto poi = kv.second[index].lock();
-                        if (poi) {
-                            builder.sTextF(TextBuilder::GREEN, "%s", icons[index]);
-                        } else {
-                            builder.sTextF(TextBuilder::RED, " %s", icons[index]);
-                        }
+            for (const auto &kv : map) {
+                TextBuilder builder;
+                builder.textF("[%d] %d ", vid, idx);
+                ++idx;
+                for (int index = 0; index < 3; ++index) {
+                    if (!kv.second[index].expired()) {
+                        builder.sTextF(TextBuilder::GREEN, "%s", icons[index]);
+                    } else {
+                        builder.sTextF(TextBuilder::RED, " %s", icons[index]);
                     }
-                    actor->setNameTag(builder.get());
                 }
+                tags[kv.first] = builder.get();
             }
 
-            auto tickMap = Village_getDwellerTickMap(v);
-            int index = 0;
-            for (const auto &i : tickMap) {
-                for (auto &kv : i) {
-                    auto ac = Global<Level>->fetchEntity(kv.first, false);
-                    if (ac) {
-                        if (index == DwellerType::Villager) {
-                            ac->setNameTag(ac->getNameTag() + " " + std::to_string(kv.second.tick));
-                        } else {
-                            ac->setNameTag(std::to_string(kv.second.tick));
-                        }
+            const auto &tickMap = Village_getDwellerTickMap(v);
+            for (size_t index = 0; index < tickMap.size(); index++) {
+                for (const auto &kv : tickMap[index]) {
+                    auto &tag = tags[kv.first];
+                    if (index == DwellerType::Villager && !tag.empty()) {
+                        tag += " " + std::to_string(kv.second.tick);
+                    } else {
+                        tag = std::to_string(kv.second.tick);
                     }
                 }
-                index++;
             }
         }
 
-        int getVIDFormPool(const std::string &uid) {
-            static int next_id = 1;
-            static std::unordered_map<std::string, int> uid_pool;
-            auto it = uid_pool.find(uid);
-            if (it != uid_pool.end()) {
-                return it->second;
-            } else {
-                uid_pool[uid] = next_id;
-                next_id++;
-                return next_id - 1;
+        // 村庄派生数据的刷新间隔
+        constexpr uint64_t VILLAGE_REFRESH_INTERVAL = 20;
+        // 超过这个时间没有tick的村庄视为已卸载
+        constexpr uint64_t VILLAGE_UNLOAD_TIMEOUT = 40;
+        // 超过这个时间没出现过的村庄不再保留VID
+        constexpr uint64_t VID_EXPIRE_TIME = 72000;
+
+        std::vector<VillagePOI> Village_collectPOIs(Village *v, std::array<size_t, 3> &count) {
+            std::vector<VillagePOI> pois;
+            count = {0, 0, 0};
+            for (const auto &kv : Village_getDwellerPOIMap(v)) {
+                for (int i = 0; i < 3; i++) {
+                    auto poi = kv.second[i].lock();
+                    if (poi) {
+                        ++count[i];
+                        pois.push_back({fromBlockPos(poi->getPosition()), i, kv.first.id});
+                    }
+                }
             }
+            return pois;
         }
 
-        TAABB getIronSpawnArea(const Vec3 &center) {
-            auto vc = fromVec3(center);
-            return {vc - TVec3(8, 6, 8), vc + TVec3(9, 7, 9)};
+        std::vector<int64_t> Village_collectDwellers(Village *v) {
+            std::vector<int64_t> dwellers;
+            for (const auto &m : Village_getDwellerTickMap(v)) {
+                for (const auto &kv : m) {
+                    dwellers.push_back(kv.first.id);
+                }
+            }
+            return dwellers;
+        }
+
+        uint64_t currentTick() { return Global<Level>->getCurrentServerTick().t; }
+
+        TAABB getIronSpawnArea(const TVec3 &center) {
+            return {center - TVec3(8, 6, 8), center + TVec3(9, 7, 9)};
         }
 
         TAABB getPOIQueryRange(const TAABB &bound) {
@@ -124,22 +150,21 @@ namespace trapdoor {
         if (this->showHeadInfo) {
             this->setVillagerHeadInfo();
         }
-        for (auto kv : this->vs_) {
-            auto v = kv.second;
+        for (auto &kv : this->villages) {
+            auto &info = kv.second;
+            auto bounds = TAABB(info.boundMin, info.boundMax);
             if (this->showBounds) {
-                trapdoor::drawAABB(fromAABB(v->getBounds()), trapdoor::PCOLOR::RED, false, 0);
+                trapdoor::drawAABB(bounds, trapdoor::PCOLOR::RED, false, 0);
             }
             if (this->showIronSpawn) {
-                trapdoor::drawAABB(getIronSpawnArea(v->getCenter()), trapdoor::PCOLOR::BLUE, false,
-                                   0);
+                trapdoor::drawAABB(getIronSpawnArea(info.center), trapdoor::PCOLOR::BLUE, false, 0);
             }
             if (this->showCenter) {
-                trapdoor::spawnParticle(fromVec3(v->getCenter()) + TVec3(0.5f, 0.9f, 0.5f),
+                trapdoor::spawnParticle(info.center + TVec3(0.5f, 0.9f, 0.5f),
                                         "minecraft:heart_particle", 0);
             }
             if (this->showPoiQuery) {
-                trapdoor::drawAABB(getPOIQueryRange(fromAABB(v->getBounds())),
-                                   trapdoor::PCOLOR::BLUE, false, 0);
+                trapdoor::drawAABB(getPOIQueryRange(bounds), trapdoor::PCOLOR::BLUE, false, 0);
             }
         }
     }
@@ -147,76 +172,193 @@ namespace trapdoor {
     void VillageHelper::lightTick() {
         static int refresh_time = 0;
         refresh_time = (refresh_time + 1) % 20;
-        if (refresh_time == 0) {
-            this->vs_.clear();
+        if (refresh_time != 0) return;
+        auto gt = currentTick();
+        for (auto it = this->villages.begin(); it != this->villages.end();) {
+            auto cur = it++;
+            if (gt - cur->second.lastTick > VILLAGE_UNLOAD_TIMEOUT) {
+                this->removeVillage(cur);
+            }
         }
+
+        static int expire_time = 0;
+        expire_time = (expire_time + 1) % 60;
+        if (expire_time != 0) return;
+        for (auto it = this->vidPool.begin(); it != this->vidPool.end();) {
+            if (gt - it->second.lastSeen > VID_EXPIRE_TIME &&
+                this->villages.find(it->second.vid) == this->villages.end()) {
+                this->timeline.forgetVillage(it->second.vid);
+                it = this->vidPool.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    int VillageHelper::getVID(const std::string &uuid, uint64_t gt) {
+        auto it = this->vidPool.find(uuid);
+        if (it != this->vidPool.end()) {
+            it->second.lastSeen = gt;
+            return it->second.vid;
+        }
+        auto vid = this->nextVid++;
+        this->vidPool[uuid] = {vid, gt};
+        return vid;
+    }
+
+    void VillageHelper::notify(VillageEvent event, const VillageInfo &info) {
+        for (auto &listener : this->listeners) {
+            listener(event, info);
+        }
+    }
+
+    void VillageHelper::refreshVillageInfo(VillageInfo &info, uint64_t gt) {
+        auto *v = info.village;
+        auto bounds = v->getBounds();
+        info.boundMin = fromVec3(bounds.min);
+        info.boundMax = fromVec3(bounds.max);
+        info.center = fromVec3(v->getCenter());
+        info.radius = v->getApproximateRadius();
+        info.dwellerCount = Village_getDwellerCount(v);
+        info.bedCount = v->getBedPOICount();
+        info.lastRefresh = gt;
+        auto pois = Village_collectPOIs(v, info.poiCount);
+        auto dwellers = Village_collectDwellers(v);
+        this->timeline.updatePOIs(info.vid, gt, pois);
+        this->timeline.updateDwellers(info.vid, gt, dwellers);
+        this->index.update(info.vid, info.boundMin, info.boundMax, info.center, std::move(pois),
+                           std::move(dwellers));
     }
 
-    void VillageHelper::insertVillage(Village *village) {
+    void VillageHelper::removeVillage(std::map<int, VillageInfo>::iterator it) {
+        auto &info = it->second;
+        // 卸载事件发生时村庄对象可能正在析构，监听者不应再访问village指针
+        if (info.village) this->ptrIndex.erase(info.village);
+        info.village = nullptr;
+        this->index.remove(info.vid);
+        this->timeline.forgetSnapshot(info.vid);
+        this->notify(VillageEvent::Unloaded, info);
+        this->villages.erase(it);
+    }
+
+    int VillageHelper::findVID(Village *village) {
+        auto pit = this->ptrIndex.find(village);
+        if (pit == this->ptrIndex.end()) return -1;
+        auto it = this->villages.find(pit->second);
+        if (it == this->villages.end()) {
+            this->ptrIndex.erase(pit);
+            return -1;
+        }
+        if (it->second.rawUuid != Village_rawUUID(village)) {
+            this->removeVillage(it);
+            this->ptrIndex.erase(village);
+            return -1;
+        }
+        return it->first;
+    }
+
+    void VillageHelper::onVillageTick(Village *village) {
         if (!village) return;
-        auto uid = village->getUniqueID().asString();
-        auto vid = getVIDFormPool(uid);
-        this->vs_.insert({vid, village});
+        auto gt = currentTick();
+        auto vid = this->findVID(village);
+        if (vid >= 0) {
+            auto &info = this->villages[vid];
+            info.lastTick = gt;
+            if (gt - info.lastRefresh >= VILLAGE_REFRESH_INTERVAL) {
+                this->refreshVillageInfo(info, gt);
+                this->vidPool[info.uuid].lastSeen = gt;
+                this->notify(VillageEvent::Updated, info);
+            }
+            return;
+        }
+
+        auto uuid = village->getUniqueID().asString();
+        vid = this->getVID(uuid, gt);
+        auto old = this->villages.find(vid);
+        if (old != this->villages.end()) {
+            // 同一个村庄换了对象(重新加载)，旧对象视为卸载
+            this->removeVillage(old);
+        }
+        auto &info = this->villages[vid];
+        info.vid = vid;
+        info.uuid = uuid;
+        info.rawUuid = Village_rawUUID(village);
+        info.village = village;
+        info.lastTick = gt;
+        this->ptrIndex[village] = vid;
+        this->refreshVillageInfo(info, gt);
+        this->notify(VillageEvent::FirstSeen, info);
+    }
+
+    void VillageHelper::onVillageDestroy(Village *village) {
+        auto vid = this->findVID(village);
+        if (vid < 0) return;
+        this->removeVillage(this->villages.find(vid));
+    }
+
+    void VillageHelper::onDefenderSpawned(Village *village, int64_t golem, const TBlockPos &pos) {
+        auto vid = this->findVID(village);
+        if (vid < 0) return;
+        this->timeline.recordGolemSpawn(vid, currentTick(), golem, pos);
     }
 
     void VillageHelper::setVillagerHeadInfo() {
-        for (auto &kv : this->vs_) {
-            Village_showHeadInfo(kv.first, kv.second);
+        // 先算好所有村民的文本，每个实体只查找一次，文本没变化就不再设置
+        HeadInfoMap tags;
+        for (auto &kv : this->villages) {
+            if (kv.second.village) {
+                Village_collectHeadInfo(kv.first, kv.second.village, tags);
+            }
+        }
+        for (auto &kv : tags) {
+            auto *actor = Global<Level>->fetchEntity(kv.first, false);
+            if (actor && actor->getNameTag() != kv.second) {
+                actor->setNameTag(kv.second);
+            }
         }
     }
     ActionResult VillageHelper::listTickingVillages(bool details) {
-        if (this->vs_.empty()) {
+        if (this->villages.empty()) {
             return {"no village in ticking", true};
         }
 
         trapdoor::TextBuilder builder;
-        for (auto kv : this->vs_) {
-            if (kv.second) {
-                auto v = kv.second;
-                auto bound = fromAABB(v->getBounds());
-                auto dc_map = Village_getDwellerCount(v);
-                builder.text(" - ")
-                    .sTextF(TextBuilder::GREEN, "[%d] ", kv.first)
-                    .pos(trapdoor::fromVec3(v->getCenter()).toBlockPos())
-                    .text(" r:")
-                    .num(v->getApproximateRadius())
-                    .text(" p:")
-                    .num(dc_map[static_cast<size_t>(DwellerType::Villager)])
-                    .text(" g:")
-                    .num(dc_map[static_cast<size_t>(DwellerType::IronGolem)])
-                    .text(" b:")
-                    .num(v->getBedPOICount())
-                    .text(" [")
-                    .pos(bound.p1.toBlockPos())
-                    .text("")
-                    .pos(bound.p2.toBlockPos())
-                    .text("]\n");
-            }
+        for (auto &kv : this->villages) {
+            auto &info = kv.second;
+            auto &dc_map = info.dwellerCount;
+            builder.text(" - ")
+                .sTextF(TextBuilder::GREEN, "[%d] ", kv.first)
+                .pos(info.center.toBlockPos())
+                .text(" r:")
+                .num(info.radius)
+                .text(" p:")
+                .num(dc_map[static_cast<size_t>(DwellerType::Villager)])
+                .text(" g:")
+                .num(dc_map[static_cast<size_t>(DwellerType::IronGolem)])
+                .text(" b:")
+                .num(info.bedCount)
+                .text(" [")
+                .pos(info.boundMin.toBlockPos())
+                .text("")
+                .pos(info.boundMax.toBlockPos())
+                .text("]\n");
         }
         return {builder.get(), true};
     }
 
     ActionResult VillageHelper::printDetails(int vid, const Vec3 &pos) {
-        if (this->vs_.empty()) {
+        if (this->villages.empty()) {
             return {"no village", false};
         }
 
         if (vid == -1) {
-            vid = this->vs_.begin()->first;
-            auto dis = pos.distanceTo(this->vs_.begin()->second->getCenter());
-            for (auto &kv : this->vs_) {
-                auto newDis = pos.distanceTo(kv.second->getCenter());
-                if (dis > newDis) {
-                    dis = newDis;
-                    vid = kv.first;
-                }
-            }
+            vid = this->index.nearest(fromVec3(pos));
         }
-        auto it = this->vs_.find(vid);
-        if (it == this->vs_.end()) {
+        auto it = this->villages.find(vid);
+        if (it == this->villages.end() || !it->second.village) {
             return {"invalid index", false};
         }
-        auto vill = it->second;
+        auto vill = it->second.village;
 
         TextBuilder builder;
         auto center = vill->getCenter().toBlockPos();
@@ -243,7 +385,7 @@ namespace trapdoor {
             .text(
                 "POIS:\n      Bed               |         Alarm          |     "
                 "              Work         |\n");
-        auto map = Village_getDwellerPOIMap(vill);
+        const auto &map = Village_getDwellerPOIMap(vill);
         bool existAlarm = false;
         for (auto &villager : map) {
             for (int index = 0; index < 3; ++index) {
@@ -274,6 +416,65 @@ namespace trapdoor {
         return {builder.get(), true};
     }
 
+    ActionResult VillageHelper::printTimeline(int vid, int duration) {
+        if (duration <= 0) {
+            return {"Duration should be greater than 0", false};
+        }
+        auto *log = this->timeline.getLog(vid);
+        if (!log || log->size() == 0) {
+            return {"No record of this village", false};
+        }
+        auto gt = currentTick();
+        auto begin = gt > static_cast<uint64_t>(duration) ? gt - duration : 0;
+        auto counts = this->timeline.countInRange(vid, begin, gt);
+        const float hour = static_cast<float>(duration) / 72000.0f;
+        auto golems = counts[static_cast<size_t>(VillageRecordType::GolemSpawn)];
+
+        TextBuilder builder;
+        builder.sTextF(TB::BOLD | TB::WHITE, "-- [%d] last %d gt --\n", vid, duration)
+            .text(" - Golem spawn: ")
+            .num(golems)
+            .text(", ")
+            .num(static_cast<float>(golems) / hour)
+            .text("/h\n")
+            .text(" - POI claim / lost: ")
+            .num(counts[static_cast<size_t>(VillageRecordType::POIClaim)])
+            .text(" / ")
+            .num(counts[static_cast<size_t>(VillageRecordType::POILost)])
+            .text("\n")
+            .text(" - Dweller join / leave: ")
+            .num(counts[static_cast<size_t>(VillageRecordType::DwellerJoin)])
+            .text(" / ")
+            .num(counts[static_cast<size_t>(VillageRecordType::DwellerLeave)])
+            .text("\n");
+
+        auto r = log->range(begin, gt);
+        auto first = r.second - std::min<size_t>(r.second - r.first, 10);
+        for (auto i = first; i < r.second; i++) {
+            const auto &rec = log->at(i);
+            builder.sText(TB::GRAY, " - ")
+                .textF("%llu %s ", static_cast<unsigned long long>(rec.tick),
+                       villageRecordName(rec.type))
+                .pos({rec.x, rec.y, rec.z})
+                .text("\n");
+        }
+        return {builder.get(), true};
+    }
+
+    ActionResult VillageHelper::exportTimeline(int vid, int duration) {
+        if (!this->timeline.getLog(vid)) {
+            return {"No record of this village", false};
+        }
+        auto gt = currentTick();
+        uint64_t begin = 0;
+        if (duration > 0 && gt > static_cast<uint64_t>(duration)) begin = gt - duration;
+        const std::string path = "./plugins/trapdoor/village_" + std::to_string(vid) + ".csv";
+        if (!this->timeline.exportCSV(vid, begin, gt, path)) {
+            return {"Can not write file " + path, false};
+        }
+        return {"Exported to " + path, true};
+    }
+
     ActionResult VillageHelper::setShowBounds(bool able) {
         this->showBounds = able;
         return {"", true};
@@ -295,7 +496,7 @@ namespace trapdoor {
     }
 
     ActionResult VillageHelper::setShowVillagerHeadInfo(bool able) {
-        this->showHeadInfo = true;
+        this->showHeadInfo = able;
         return {"", true};
     }
 
@@ -305,28 +506,29 @@ namespace trapdoor {
         }
         auto aUid = actor->getUniqueID();
 
-        for (auto v : this->vs_) {
-            auto dweller_map = Village_getDwellerPOIMap(v.second);
-            auto iter = dweller_map.find(aUid);
-
-            const static std::string name[] = {"Bed", "Alarm", "Work"};
-            if (iter != dweller_map.end()) {
-                TextBuilder builder;
-                builder.textF("VID: %d\n", v.first);
-                for (int i = 0; i < 3; i++) {
-                    const auto &poi = iter->second[i].lock();
-                    if (poi) {
-                        builder.textF("%s: [%d %d %d],%d/%d %.2f %zu\n", poi->getTypeName(),
-                                      poi->getPosition().x, poi->getPosition().y,
-                                      poi->getPosition().z, poi->getOwnerCount(),
-                                      poi->getOwnerCapacity(), poi->getRadius(), poi->getWeight());
+        auto vid = this->index.dwellerVillage(aUid.id);
+        auto it = this->villages.find(vid);
+        if (it == this->villages.end() || !it->second.village) {
+            return false;
+        }
+        const auto &dweller_map = Village_getDwellerPOIMap(it->second.village);
+        auto iter = dweller_map.find(aUid);
+        if (iter != dweller_map.end()) {
+            TextBuilder builder;
+            builder.textF("VID: %d\n", vid);
+            for (int i = 0; i < 3; i++) {
+                const auto &poi = iter->second[i].lock();
+                if (poi) {
+                    builder.textF("%s: [%d %d %d],%d/%d %.2f %zu\n", poi->getTypeName(),
+                                  poi->getPosition().x, poi->getPosition().y, poi->getPosition().z,
+                                  poi->getOwnerCount(), poi->getOwnerCapacity(), poi->getRadius(),
+                                  poi->getWeight());
 
-                        trapdoor::shortHighlightBlock(fromBlockPos(poi->getPosition()),
-                                                      PCOLOR::YELLOW, 0);
-                    }
+                    trapdoor::shortHighlightBlock(fromBlockPos(poi->getPosition()), PCOLOR::YELLOW,
+                                                  0);
                 }
-                p->sendText(builder.get());
             }
+            p->sendText(builder.get());
         }
 
         return false;
@@ -335,6 +537,27 @@ namespace trapdoor {
 
 THook(void, "?tick@Village@@QEAAXUTick@@AEAVBlockSource@@@Z", Village *village, void *tick,
       void *bs) {
-    trapdoor::mod().getVillageHelper().insertVillage(village);
+    trapdoor::mod().getVillageHelper().onVillageTick(village);
     original(village, tick, bs);
-}
\ No newline at end of file
+}
+
+THook(void, "??1Village@@QEAA@XZ", Village *village) {
+    trapdoor::mod().getVillageHelper().onVillageDestroy(village);
+    original(village);
+}
+
+THook(void, "?_trySpawnDefenderDwellers@Village@@AEAAXAEAVBlockSource@@_K@Z", Village *village,
+      void *bs, uint64_t tick) {
+    auto &golems = trapdoor::Village_getDwellerTickMap(village)[trapdoor::DwellerType::IronGolem];
+    std::vector<int64_t> before;
+    before.reserve(golems.size());
+    for (const auto &kv : golems) before.push_back(kv.first.id);
+    original(village, bs, tick);
+    if (golems.size() <= before.size()) return;
+    for (const auto &kv : golems) {
+        if (std::find(before.begin(), before.end(), kv.first.id) == before.end()) {
+            trapdoor::mod().getVillageHelper().onDefenderSpawned(village, kv.first.id,
+                                                                kv.second.pos);
+        }
+    }
+}
@@ -0,0 +1,200 @@
+#include "VillageIndex.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace trapdoor {
+    namespace {
+        // 最近邻按区块圈层向外搜索的最大圈数，超出后直接遍历所有村庄
+        constexpr int NEAREST_MAX_RING = 8;
+
+        inline int toChunk(float v) { return static_cast<int>(std::floor(v)) >> 4; }
+
+        inline int toChunk(int v) { return v >> 4; }
+
+        inline uint64_t cellKey(int cx, int cz) {
+            return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) |
+                   static_cast<uint32_t>(cz);
+        }
+
+        inline bool inside(const TVec3 &p, const TVec3 &min, const TVec3 &max) {
+            return p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y && p.z >= min.z &&
+                   p.z <= max.z;
+        }
+
+        inline float distance2(const TVec3 &a, const TVec3 &b) {
+            auto dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+            return dx * dx + dy * dy + dz * dz;
+        }
+    }  // namespace
+
+    void VillageIndex::eraseFromCell(uint64_t key, std::vector<int> Cell::*list, int vid) {
+        auto it = this->cells.find(key);
+        if (it == this->cells.end()) return;
+        auto &v = it->second.*list;
+        v.erase(std::remove(v.begin(), v.end(), vid), v.end());
+        if (it->second.empty()) this->cells.erase(it);
+    }
+
+    void VillageIndex::unlinkBounds(int vid, const Entry &entry) {
+        for (auto key : entry.boundCells) {
+            this->eraseFromCell(key, &Cell::bounds, vid);
+        }
+        this->eraseFromCell(cellKey(toChunk(entry.center.x), toChunk(entry.center.z)),
+                            &Cell::centers, vid);
+    }
+
+    void VillageIndex::linkBounds(int vid, Entry &entry) {
+        entry.boundCells.clear();
+        auto x0 = toChunk(entry.boundMin.x), x1 = toChunk(entry.boundMax.x);
+        auto z0 = toChunk(entry.boundMin.z), z1 = toChunk(entry.boundMax.z);
+        for (int x = x0; x <= x1; x++) {
+            for (int z = z0; z <= z1; z++) {
+                auto key = cellKey(x, z);
+                entry.boundCells.push_back(key);
+                this->cells[key].bounds.push_back(vid);
+            }
+        }
+        this->cells[cellKey(toChunk(entry.center.x), toChunk(entry.center.z))].centers.push_back(
+            vid);
+    }
+
+    void VillageIndex::unlinkPOIs(int vid, const Entry &entry) {
+        for (const auto &poi : entry.pois) {
+            auto it = this->cells.find(cellKey(toChunk(poi.pos.x), toChunk(poi.pos.z)));
+            if (it == this->cells.end()) continue;
+            auto &v = it->second.pois;
+            v.erase(std::remove_if(v.begin(), v.end(),
+                                   [vid](const std::pair<int, size_t> &p) { return p.first == vid; }),
+                    v.end());
+            if (it->second.empty()) this->cells.erase(it);
+        }
+        for (auto uid : entry.dwellers) {
+            auto it = this->dwellerIndex.find(uid);
+            if (it != this->dwellerIndex.end() && it->second == vid) this->dwellerIndex.erase(it);
+        }
+    }
+
+    void VillageIndex::linkPOIs(int vid, const Entry &entry) {
+        for (size_t i = 0; i < entry.pois.size(); i++) {
+            auto &pos = entry.pois[i].pos;
+            this->cells[cellKey(toChunk(pos.x), toChunk(pos.z))].pois.emplace_back(vid, i);
+        }
+        for (auto uid : entry.dwellers) {
+            this->dwellerIndex[uid] = vid;
+        }
+    }
+
+    void VillageIndex::update(int vid, const TVec3 &boundMin, const TVec3 &boundMax,
+                              const TVec3 &center, std::vector<VillagePOI> pois,
+                              std::vector<int64_t> dwellers) {
+        auto it = this->entries.find(vid);
+        if (it == this->entries.end()) {
+            auto &entry = this->entries[vid];
+            entry.boundMin = boundMin;
+            entry.boundMax = boundMax;
+            entry.center = center;
+            entry.pois = std::move(pois);
+            entry.dwellers = std::move(dwellers);
+            this->linkBounds(vid, entry);
+            this->linkPOIs(vid, entry);
+            return;
+        }
+
+        auto &entry = it->second;
+        // 范围不变时(绝大多数刷新)只替换POI和居民
+        if (entry.boundMin != boundMin || entry.boundMax != boundMax || entry.center != center) {
+            this->unlinkBounds(vid, entry);
+            entry.boundMin = boundMin;
+            entry.boundMax = boundMax;
+            entry.center = center;
+            this->linkBounds(vid, entry);
+        }
+        this->unlinkPOIs(vid, entry);
+        entry.pois = std::move(pois);
+        entry.dwellers = std::move(dwellers);
+        this->linkPOIs(vid, entry);
+    }
+
+    void VillageIndex::remove(int vid) {
+        auto it = this->entries.find(vid);
+        if (it == this->entries.end()) return;
+        this->unlinkBounds(vid, it->second);
+        this->unlinkPOIs(vid, it->second);
+        this->entries.erase(it);
+    }
+
+    void VillageIndex::clear() {
+        this->entries.clear();
+        this->cells.clear();
+        this->dwellerIndex.clear();
+    }
+
+    int VillageIndex::containing(const TVec3 &pos) const {
+        auto it = this->cells.find(cellKey(toChunk(pos.x), toChunk(pos.z)));
+        if (it == this->cells.end()) return -1;
+        for (auto vid : it->second.bounds) {
+            auto &entry = this->entries.at(vid);
+            if (inside(pos, entry.boundMin, entry.boundMax)) return vid;
+        }
+        return -1;
+    }
+
+    int VillageIndex::nearest(const TVec3 &pos, float *distance) const {
+        if (this->entries.empty()) return -1;
+        int best = -1;
+        float bestDis2 = 0;
+        auto check = [&](int vid) {
+            auto d = distance2(pos, this->entries.at(vid).center);
+            if (best == -1 || d < bestDis2) {
+                best = vid;
+                bestDis2 = d;
+            }
+        };
+
+        auto cx = toChunk(pos.x), cz = toChunk(pos.z);
+        bool done = false;
+        for (int r = 0; r <= NEAREST_MAX_RING; r++) {
+            // 第r圈里的点与查询点的水平距离至少是(r-1)*16
+            if (best != -1) {
+                auto minDis = static_cast<float>((r - 1) * 16);
+                if (minDis > 0 && minDis * minDis > bestDis2) {
+                    done = true;
+                    break;
+                }
+            }
+            for (int x = cx - r; x <= cx + r; x++) {
+                for (int z = cz - r; z <= cz + r; z++) {
+                    if (std::max(std::abs(x - cx), std::abs(z - cz)) != r) continue;
+                    auto it = this->cells.find(cellKey(x, z));
+                    if (it == this->cells.end()) continue;
+                    for (auto vid : it->second.centers) check(vid);
+                }
+            }
+        }
+
+        if (!done) {
+            for (auto &kv : this->entries) check(kv.first);
+        }
+        if (distance) *distance = std::sqrt(bestDis2);
+        return best;
+    }
+
+    const VillagePOI *VillageIndex::poiAt(const TBlockPos &pos, int *vid) const {
+        auto it = this->cells.find(cellKey(toChunk(pos.x), toChunk(pos.z)));
+        if (it == this->cells.end()) return nullptr;
+        for (auto &p : it->second.pois) {
+            auto &poi = this->entries.at(p.first).pois[p.second];
+            if (poi.pos == pos) {
+                if (vid) *vid = p.first;
+                return &poi;
+            }
+        }
+        return nullptr;
+    }
+
+    int VillageIndex::dwellerVillage(int64_t uid) const {
+        auto it = this->dwellerIndex.find(uid);
+        return it == this->dwellerIndex.end() ? -1 : it->second;
+    }
+}  // namespace trapdoor
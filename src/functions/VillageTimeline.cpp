@@ -0,0 +1,186 @@
+#include "VillageTimeline.h"
+
+#include <algorithm>
+#include <climits>
+#include <fstream>
+
+namespace trapdoor {
+    namespace {
+        // 快照中表示该槽位没有POI
+        const TBlockPos NO_POI{INT_MIN, INT_MIN, INT_MIN};
+
+        const char *POI_NAMES[3] = {"bed", "alarm", "work"};
+    }  // namespace
+
+    const char *villageRecordName(VillageRecordType type) {
+        switch (type) {
+            case VillageRecordType::GolemSpawn:
+                return "golem_spawn";
+            case VillageRecordType::POIClaim:
+                return "poi_claim";
+            case VillageRecordType::POILost:
+                return "poi_lost";
+            case VillageRecordType::DwellerJoin:
+                return "dweller_join";
+            case VillageRecordType::DwellerLeave:
+                return "dweller_leave";
+            default:
+                return "unknown";
+        }
+    }
+
+    void VillageLog::push(const VillageRecord &rec) {
+        if (this->records.empty()) this->records.resize(CAPACITY);
+        this->records[this->head] = rec;
+        this->head = (this->head + 1) % CAPACITY;
+        if (this->count < CAPACITY) ++this->count;
+    }
+
+    std::pair<size_t, size_t> VillageLog::range(uint64_t begin, uint64_t end) const {
+        // 记录按游戏刻单调写入，二分查找边界
+        auto lower = [this](uint64_t t) {
+            size_t lo = 0, hi = this->count;
+            while (lo < hi) {
+                auto mid = (lo + hi) / 2;
+                if (this->at(mid).tick < t) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            return lo;
+        };
+        auto first = lower(begin);
+        auto last = end == UINT64_MAX ? this->count : lower(end + 1);
+        return {first, std::max(first, last)};
+    }
+
+    void VillageTimeline::recordGolemSpawn(int vid, uint64_t gt, int64_t golem,
+                                           const TBlockPos &pos) {
+        VillageRecord rec;
+        rec.tick = gt;
+        rec.actor = golem;
+        rec.x = pos.x;
+        rec.y = pos.y;
+        rec.z = pos.z;
+        rec.type = VillageRecordType::GolemSpawn;
+        this->logs[vid].push(rec);
+    }
+
+    void VillageTimeline::updatePOIs(int vid, uint64_t gt, const std::vector<VillagePOI> &pois) {
+        std::unordered_map<int64_t, std::array<TBlockPos, 3>> cur;
+        for (const auto &poi : pois) {
+            auto it = cur.find(poi.owner);
+            if (it == cur.end()) {
+                it = cur.insert({poi.owner, {NO_POI, NO_POI, NO_POI}}).first;
+            }
+            it->second[poi.type] = poi.pos;
+        }
+
+        auto &snap = this->snapshots[vid];
+        if (snap.hasPOIs) {
+            auto &log = this->logs[vid];
+            auto emit = [&log, gt](VillageRecordType type, int64_t owner, int slot,
+                                   const TBlockPos &pos) {
+                VillageRecord rec;
+                rec.tick = gt;
+                rec.actor = owner;
+                rec.x = pos.x;
+                rec.y = pos.y;
+                rec.z = pos.z;
+                rec.type = type;
+                rec.poiType = static_cast<uint8_t>(slot);
+                log.push(rec);
+            };
+            static const std::array<TBlockPos, 3> EMPTY{NO_POI, NO_POI, NO_POI};
+            for (const auto &kv : cur) {
+                auto it = snap.pois.find(kv.first);
+                const auto &old = it == snap.pois.end() ? EMPTY : it->second;
+                for (int i = 0; i < 3; i++) {
+                    if (old[i] == kv.second[i]) continue;
+                    if (old[i] != NO_POI) emit(VillageRecordType::POILost, kv.first, i, old[i]);
+                    if (kv.second[i] != NO_POI)
+                        emit(VillageRecordType::POIClaim, kv.first, i, kv.second[i]);
+                }
+            }
+            for (const auto &kv : snap.pois) {
+                if (cur.count(kv.first)) continue;
+                for (int i = 0; i < 3; i++) {
+                    if (kv.second[i] != NO_POI)
+                        emit(VillageRecordType::POILost, kv.first, i, kv.second[i]);
+                }
+            }
+        }
+        snap.pois.swap(cur);
+        snap.hasPOIs = true;
+    }
+
+    void VillageTimeline::updateDwellers(int vid, uint64_t gt,
+                                         const std::vector<int64_t> &dwellers) {
+        std::unordered_set<int64_t> cur(dwellers.begin(), dwellers.end());
+        auto &snap = this->snapshots[vid];
+        if (snap.hasDwellers) {
+            auto &log = this->logs[vid];
+            VillageRecord rec;
+            rec.tick = gt;
+            for (auto uid : cur) {
+                if (snap.dwellers.count(uid)) continue;
+                rec.actor = uid;
+                rec.type = VillageRecordType::DwellerJoin;
+                log.push(rec);
+            }
+            for (auto uid : snap.dwellers) {
+                if (cur.count(uid)) continue;
+                rec.actor = uid;
+                rec.type = VillageRecordType::DwellerLeave;
+                log.push(rec);
+            }
+        }
+        snap.dwellers.swap(cur);
+        snap.hasDwellers = true;
+    }
+
+    void VillageTimeline::forgetSnapshot(int vid) { this->snapshots.erase(vid); }
+
+    void VillageTimeline::forgetVillage(int vid) {
+        this->snapshots.erase(vid);
+        this->logs.erase(vid);
+    }
+
+    const VillageLog *VillageTimeline::getLog(int vid) const {
+        auto it = this->logs.find(vid);
+        return it == this->logs.end() ? nullptr : &it->second;
+    }
+
+    std::array<size_t, static_cast<size_t>(VillageRecordType::Count)>
+    VillageTimeline::countInRange(int vid, uint64_t begin, uint64_t end) const {
+        std::array<size_t, static_cast<size_t>(VillageRecordType::Count)> res{};
+        auto *log = this->getLog(vid);
+        if (!log) return res;
+        auto r = log->range(begin, end);
+        for (auto i = r.first; i < r.second; i++) {
+            ++res[static_cast<size_t>(log->at(i).type)];
+        }
+        return res;
+    }
+
+    bool VillageTimeline::exportCSV(int vid, uint64_t begin, uint64_t end,
+                                    const std::string &path) const {
+        std::ofstream f(path);
+        if (!f.is_open()) return false;
+        f << "tick,type,actor,x,y,z,poi\n";
+        auto *log = this->getLog(vid);
+        if (log) {
+            auto r = log->range(begin, end);
+            for (auto i = r.first; i < r.second; i++) {
+                const auto &rec = log->at(i);
+                bool isPOI = rec.type == VillageRecordType::POIClaim ||
+                             rec.type == VillageRecordType::POILost;
+                f << rec.tick << ',' << villageRecordName(rec.type) << ',' << rec.actor << ','
+                  << rec.x << ',' << rec.y << ',' << rec.z << ','
+                  << (isPOI ? POI_NAMES[rec.poiType] : "") << '\n';
+            }
+        }
+        return static_cast<bool>(f);
+    }
+}  // namespace trapdoor
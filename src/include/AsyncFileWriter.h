@@ -0,0 +1,49 @@
+#ifndef TRAPDOOR_ASYNC_FILE_WRITER_H
+#define TRAPDOOR_ASYNC_FILE_WRITER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace trapdoor {
+    // 在后台线程写文件，不访问任何游戏对象
+    // 同一路径还没写出去的旧内容会被新内容覆盖，先写到.tmp再重命名，写到一半崩溃也不会损坏原文件
+    class AsyncFileWriter {
+       public:
+        AsyncFileWriter() = default;
+
+        AsyncFileWriter(const AsyncFileWriter &) = delete;
+
+        AsyncFileWriter &operator=(const AsyncFileWriter &) = delete;
+
+        ~AsyncFileWriter();
+
+        void submit(const std::string &path, std::string data);
+
+        // 阻塞到队列里的内容全部写完
+        void flush();
+
+        // 在游戏线程调用，把后台线程写失败的文件记到日志里
+        void reportFailures();
+
+        // 父目录不存在时会先创建
+        static bool writeAtomically(const std::string &path, const std::string &data);
+
+       private:
+        void work();
+
+        std::mutex lock;
+        std::condition_variable cv;
+        std::condition_variable idle;
+        std::unordered_map<std::string, std::string> pending;
+        std::vector<std::string> failures;  // 写失败的路径，等游戏线程取走
+        bool writing = false;
+        bool stop = false;
+        std::thread worker;
+    };
+}  // namespace trapdoor
+
+#endif
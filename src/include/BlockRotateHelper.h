@@ -15,6 +15,9 @@ namespace trapdoor {
     ActionResult setBlockRotationAble(bool able);
     bool rotateBlock(BlockSource* bs, BlockInstance* bi, const Vec3& clickPos, unsigned char face);
     void initRotateBlockHelper();
+
+    // 对比每次点击构造正则和查表两种方式在所有方块类型上的耗时
+    ActionResult benchmarkBlockRotation(int rounds);
 }  // namespace trapdoor
 
 #endif
\ No newline at end of file
@@ -47,6 +47,7 @@ namespace trapdoor {
        public:
         CommandConfig getCommandConfig(const std::string& command);
         inline std::vector<Shortcut>& getShortcuts() { return this->shortcuts; }
+        inline const ShortcutIndex& getShortcutIndex() const { return this->shortcutIndex; }
         inline BasicConfig& getBasicConfig() { return this->basicConfig; }
         inline TweakConfig& getTweakConfig() { return this->tweakConfig; }
 
@@ -71,6 +72,7 @@ namespace trapdoor {
         TweakConfig tweakConfig;
         std::unordered_map<std::string, CommandConfig> commandsConfigs;
         std::vector<Shortcut> shortcuts;
+        ShortcutIndex shortcutIndex;
         nlohmann::json config;
     };
 
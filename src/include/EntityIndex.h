@@ -0,0 +1,108 @@
+#ifndef TRAPDOOR_ENTITY_INDEX_H
+#define TRAPDOOR_ENTITY_INDEX_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Actor;
+
+namespace trapdoor {
+    // 以(维度,区块)为桶的实体计数索引，实体类型在这里驻留成整数id
+    // 只有在有人使用(分析器、上限监视、计数命令)时才维护：第一次使用时扫描一遍所有实体，
+    // 之后由实体加入世界的钩子插入，Actor::tick只在跨区块时改动桶，析构时移除
+    // 按指针索引，另外记下实体的UniqueID，地址被新实体复用时能认出来
+    // 超过IDLE_TIMEOUT gt没人使用就清空并停止维护
+    class EntityIndex {
+       public:
+        static constexpr int DIMENSION_NUM = 3;
+        static constexpr uint64_t IDLE_TIMEOUT = 1200;
+
+        // 每gt调用一次
+        void tick();
+
+        // 读取索引前调用，索引未启用时会先扫描一遍所有实体
+        void use();
+
+        inline bool isActive() const { return this->active; }
+
+        // 实体加入世界或者tick时更新，只在isActive()时调用
+        void update(Actor *actor);
+
+        uint16_t internType(const std::string &name);
+
+        inline const std::string &typeName(uint16_t type) const { return this->typeNames[type]; }
+
+        inline size_t typeCount() const { return this->typeNames.size(); }
+
+        // 已经索引过的实体更新位置，返回false表示这个实体还没被索引
+        // uid和记录的不一致说明是复用了地址的新实体，旧条目会被移除
+        bool touch(const void *actor, int64_t uid, int dim, int cx, int cz);
+
+        void insert(const void *actor, int64_t uid, int dim, int cx, int cz, uint16_t type,
+                    bool surface);
+
+        void remove(const void *actor);
+
+        void clear();
+
+        inline size_t size() const { return this->entries.size(); }
+
+        // 以(cx,cz)为中心，切比雪夫距离不超过r的区块内的计数，f(type, surface, count)
+        template <typename F>
+        void forEachInRange(int dim, int cx, int cz, int r, F &&f) const {
+            if (dim < 0 || dim >= DIMENSION_NUM) return;
+            auto &chunks = this->buckets[dim];
+            for (int x = cx - r; x <= cx + r; x++) {
+                for (int z = cz - r; z <= cz + r; z++) {
+                    auto it = chunks.find(chunkKey(x, z));
+                    if (it == chunks.end()) continue;
+                    auto &counts = it->second.counts;
+                    for (size_t slot = 0; slot < counts.size(); slot++) {
+                        if (counts[slot] == 0) continue;
+                        f(static_cast<uint16_t>(slot >> 1), (slot & 1) != 0, counts[slot]);
+                    }
+                }
+            }
+        }
+
+        // 按类型汇总的计数，下标是类型id
+        std::vector<size_t> countInRange(int dim, int cx, int cz, int r) const;
+
+        std::vector<size_t> countAll(int dim) const;
+
+        static inline uint64_t chunkKey(int cx, int cz) {
+            return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) |
+                   static_cast<uint32_t>(cz);
+        }
+
+       private:
+        struct Entry {
+            int dim = 0;
+            uint64_t chunk = 0;
+            uint32_t slot = 0;  // type * 2 + surface
+            int64_t uid = 0;
+        };
+
+        struct Bucket {
+            uint32_t total = 0;
+            std::vector<uint32_t> counts;  // 按slot存放
+        };
+
+        void link(const Entry &entry);
+        void unlink(const Entry &entry);
+
+        std::unordered_map<const void *, Entry> entries;
+        std::array<std::unordered_map<uint64_t, Bucket>, DIMENSION_NUM> buckets;
+        std::array<std::vector<uint32_t>, DIMENSION_NUM> totals;
+        std::vector<std::string> typeNames;
+        std::unordered_map<std::string, uint16_t> typeIds;
+        uint64_t currentTick = 0;
+        uint64_t lastUse = 0;
+        bool active = false;
+    };
+}  // namespace trapdoor
+
+#endif
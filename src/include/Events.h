@@ -8,6 +8,7 @@ namespace trapdoor {
     void subscribePlayerStartDestroyBlockEvent();
     void subscribePlayerPlaceBlockEvent();
     void subscribePlayerInventoryChangeEvent();
+    void subscribePlayerLeftEvent();
     void subscribeServerStartEvent();
 
     inline void SubscribeEvents() {
@@ -17,6 +18,7 @@ namespace trapdoor {
         subscribePlayerStartDestroyBlockEvent();
         subscribePlayerPlaceBlockEvent();
         subscribePlayerInventoryChangeEvent();
+        subscribePlayerLeftEvent();
         subscribeServerStartEvent();
     }
 
@@ -1,11 +1,14 @@
 #ifndef TRAPDOOR_MINIHUD_HELPER_H
 #define TRAPDOOR_MINIHUD_HELPER_H
 #include <array>
+#include <cstdint>
 #include <unordered_map>
+#include <vector>
 
 #include "CommandHelper.h"
 
 namespace trapdoor {
+    // 同时也是玩家掩码中的位序号
     enum HUDInfoType {
         Base = 0,
         Mspt = 1,
@@ -13,13 +16,29 @@ namespace trapdoor {
         Redstone = 3,
         Counter = 4,
         Chunk = 5,
-        Unknown = 6,
+        Cap = 6,
+        Unknown = 7,
+    };
+
+    // 栏目的开销等级，服务器卡顿时开销越大的栏目刷新间隔放得越长
+    enum class HUDCost { Cheap = 0, Normal = 1, Heavy = 2 };
+
+    typedef std::string (*HUDSectionBuilder)(Player*);
+
+    struct HUDSection {
+        const char* name;
+        HUDInfoType type;
+        int interval;             // 每隔多少轮HUD刷新重建一次文本
+        HUDCost cost;
+        HUDSectionBuilder build;  // 为空表示该栏目不输出文本(比如chunk)
     };
 
     struct PlayerHudInfo {
         std::string realName;
         bool enable;
-        std::array<int, 7> config{};
+        uint32_t mask = 0;
+        std::array<std::string, HUDInfoType::Unknown> cache{};
+        std::array<size_t, HUDInfoType::Unknown> lastRefresh{};
     };
 
     class HUDHelper {
@@ -36,10 +55,13 @@ namespace trapdoor {
 
         ActionResult setAblePlayer(const std::string& playerName, bool able);
 
+        static std::vector<std::string> getSectionNames();
+
        private:
         void tickChunk();
 
         bool enable = false;
+        size_t round = 0;
         std::unordered_map<std::string, PlayerHudInfo> playerInfos;
     };
 
@@ -1,8 +1,15 @@
 #ifndef TRAPDOOR_HSA_HELPER
 #define TRAPDOOR_HSA_HELPER
 
-#include <set>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
+#include "AsyncFileWriter.h"
 #include "CommandHelper.h"
 #include "TBlockPos.h"
 
@@ -15,30 +22,57 @@ namespace trapdoor {
         int dimensionID = 0;
 
         bool operator<(const HsaInfo &rhs) const;
+        bool operator==(const HsaInfo &rhs) const;
     };
 
+    // 以(维度,区块)为桶的HSA索引，每个HSA挂在它覆盖的所有区块上
+    // 启动时从文件加载，有变化时定期写回，另外会主动扫描玩家附近已加载区块里的HSA
     class HsaManager {
-        bool showHsa = false;
-        std::set<HsaInfo> hsaList;
-
        public:
-        inline void insert(HsaInfo info) { this->hsaList.insert(info); }
+        static constexpr int SCAN_RADIUS = 4;
+        static constexpr size_t SCAN_CHUNKS_PER_ROUND = 32;
+        static constexpr size_t MAX_BOXES_PER_TICK = 8;
 
-        void HeavyTick();
+        void insert(const HsaInfo &info);
 
-        ActionResult place();
+        void HeavyTick();
 
-        inline ActionResult clear() {
-            auto num = this->hsaList.size();
-            this->hsaList.clear();
-            return {std::to_string(num), true};
-        }
+        ActionResult clear();
 
         inline ActionResult ShowHsa(bool show) {
             this->showHsa = show;
             return {"~", true};
         }
+
+        // 包含该方块的HSA，没有返回nullptr
+        const HsaInfo *find(int dim, const TBlockPos &pos) const;
+
+        inline const std::vector<HsaInfo> &getAll() const { return this->hsaList; }
+
+        void load(const std::string &path);
+
+        void save();
+
+       private:
+        void pruneScanned();
+
+        void scanLoadedChunks();
+
+        void collectVisible();
+
+        void drawQueued();
+
+        bool showHsa = false;
+        bool dirty = false;
+        std::string filePath;
+        std::vector<HsaInfo> hsaList;
+        std::array<std::unordered_map<uint64_t, std::vector<uint32_t>>, 3> cells;
+        std::array<std::unordered_set<uint64_t>, 3> scannedChunks;  // 只保留玩家附近的区块
+        std::deque<uint32_t> drawQueue;  // 本轮还没画的HSA下标
+        AsyncFileWriter writer;
     };
+
+    const char *structureName(StructureType type);
 }  // namespace trapdoor
 
 #endif
@@ -7,11 +7,43 @@
 #include <MC/BlockInstance.hpp>
 #include <MC/Inventory.hpp>
 #include <MC/Player.hpp>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 namespace trapdoor {
     bool onStartDestroyBlock(Player * player, const BlockInstance &instance);
 
     void swapItemInContainer(Container & cont, int s1, int s2);
 
+    // 每个玩家背包的物品索引：物品id -> 格子列表，以及每种方块的最快工具
+    // 第一次查询时建立，之后由背包变化事件按格子增量更新
+    class InventoryIndex {
+       public:
+        // 包含该物品的第一个格子，没有返回-1
+        int findItem(Player * player, int itemId);
+
+        // 耐久足够的格子里对该方块最快的工具，返回(速度, 格子)，没有返回(0, -1)
+        std::pair<float, int> bestTool(Player * player, const Block *block);
+
+        void onSlotChanged(Player * player, int slot);
+
+        void remove(Player * player);
+
+       private:
+        struct Entry {
+            bool built = false;
+            std::vector<int> slotItem;  // 每个格子的物品id，空格子为0
+            std::unordered_map<int, std::vector<int>> itemSlots;
+            std::unordered_map<const Block *, std::pair<float, int>> tools;
+        };
+
+        Entry &get(Player * player);
+
+        static void rebuild(Entry & entry, Container & inv);
+
+        std::unordered_map<const Player *, Entry> entries;
+    };
+
 }  // namespace trapdoor
 
 #endif  // TRAPDOOR_INVENTORYTOOL_H
@@ -1,10 +1,85 @@
 #ifndef TRAPDOOR_SHORTCUTS_H
 #define TRAPDOOR_SHORTCUTS_H
 #include <MC/Player.hpp>
+#include <cstdint>
 #include <string>
+#include <unordered_map>
 #include <vector>
 namespace trapdoor {
     enum ShortcutType { USE = 0, USE_ON = 1, CMD, DESTROY };
+
+    // 动作里可以使用的占位符
+    enum class ShortcutArg : uint8_t { PX, PY, PZ, PDim, IName, IAux, BName, BAux, BX, BY, BZ };
+
+    constexpr uint32_t argBit(ShortcutArg arg) { return 1u << static_cast<uint32_t>(arg); }
+
+    constexpr uint32_t PLAYER_ARGS =
+        argBit(ShortcutArg::PX) | argBit(ShortcutArg::PY) | argBit(ShortcutArg::PZ);
+    constexpr uint32_t ITEM_ARGS = argBit(ShortcutArg::IName) | argBit(ShortcutArg::IAux);
+    constexpr uint32_t BLOCK_ARGS = argBit(ShortcutArg::BName) | argBit(ShortcutArg::BAux) |
+                                    argBit(ShortcutArg::BX) | argBit(ShortcutArg::BY) |
+                                    argBit(ShortcutArg::BZ);
+
+    // 执行动作时的参数，只会填写模板用到的部分
+    struct ShortcutArgs {
+        BlockPos playerPos;
+        int dim = 0;
+        std::string itemName;
+        int itemAux = 0;
+        std::string blockName;
+        int blockAux = 0;
+        BlockPos blockPos;
+    };
+
+    // 读配置时把动作字符串拆成字面量和占位符片段，执行时直接拼接，不用每次重新解析格式串
+    // 语法和原来的fmt格式一样：{px}是占位符，{{和}}是花括号本身
+    // 支持fmt的格式说明[[fill]align][sign][#][0][width][.precision][type]，如{px:+d}、{iaux:02}
+    // 整数的type可以是d x X o b B，字符串是s，不支持{:{}}这种动态宽度
+    class ActionTemplate {
+       public:
+        // allowed是允许出现的占位符集合
+        bool compile(const std::string& src, uint32_t allowed, std::string& error);
+
+        // 结果追加到out后面
+        void render(const ShortcutArgs& args, std::string& out) const;
+
+        inline uint32_t usedArgs() const { return this->used; }
+        inline size_t literalSize() const { return this->literal.size(); }
+
+       private:
+        struct FormatSpec {
+            char fill = ' ';
+            char align = 0;  // < > ^，0表示默认：数字右对齐，字符串左对齐
+            char sign = 0;   // + - 空格
+            bool alternate = false;
+            bool zeroPad = false;
+            int width = 0;
+            int precision = -1;
+            char type = 0;
+        };
+
+        struct Segment {
+            int arg;  // -1表示字面量
+            uint32_t begin;
+            uint32_t end;
+            int spec = -1;  // specs中的下标，-1表示没有格式说明
+        };
+
+        static bool parseSpec(const std::string& str, bool isString, FormatSpec& spec);
+
+        std::string literal;  // 所有字面量拼在一起，片段只记录区间
+        std::vector<Segment> segments;
+        std::vector<FormatSpec> specs;
+        uint32_t used = 0;
+    };
+
+    // 编译一组动作，出错时error里是出错的动作和原因
+    bool compileActions(const std::vector<std::string>& actions, uint32_t allowed,
+                        std::vector<ActionTemplate>& templates, std::string& error);
+
+    // 依次渲染并执行，buffer在多次执行之间复用
+    void runActions(Player* player, const std::vector<ActionTemplate>& templates,
+                    const ShortcutArgs& args, std::string& buffer);
     struct Shortcut {
         ShortcutType type;     // 类型
         std::string itemName;  // 使用的物品
@@ -14,6 +89,10 @@ namespace trapdoor {
         bool prevent = false;
 
         std::vector<std::string> actions;  // 命令
+        std::vector<ActionTemplate> templates;  // 编译好的命令
+        uint32_t usedArgs = 0;
+        std::string buffer;
+
        public:
         void setItem(const std::string& str);
         void setBlock(const std::string& str);
@@ -26,6 +105,38 @@ namespace trapdoor {
         void runUseDestroy(Player* player, const ItemStack* item, Block* block, const BlockPos& p);
 
         bool match(const Shortcut& shortcut) const;
+
+        // 读配置时调用，占位符写错或者用了这个类型没有的参数时返回false
+        bool compile(std::string& error);
+    };
+
+    // 按(类型, 物品, 方块)建立的哈希索引，读配置的时候建好
+    // 查询时依次尝试精确aux、任意aux、空名字通配，结果和按配置顺序线性匹配的第一个相同
+    class ShortcutIndex {
+       public:
+        void build(const std::vector<Shortcut>& shortcuts);
+
+        // 返回第一个匹配的快捷键的下标，没有匹配返回-1
+        int find(const Shortcut& query) const;
+
+       private:
+        struct Key {
+            int type;
+            int item;  // 名字编号，0表示空名字
+            int itemAux;
+            int block;
+            int blockAux;
+            bool operator==(const Key& rhs) const;
+        };
+
+        struct KeyHash {
+            size_t operator()(const Key& k) const;
+        };
+
+        int nameId(const std::string& name) const;
+
+        std::unordered_map<std::string, int> names;
+        std::unordered_map<Key, int, KeyHash> first;
     };
 
 }  // namespace trapdoor
@@ -1,23 +1,107 @@
 #ifndef TRAPDOOR_SIM_PLAYER_H
 #define TRAPDOOR_SIM_PLAYER_H
+#include <MC/ActorUniqueID.hpp>
+#include <MC/BlockPos.hpp>
 #include <MC/BlockSource.hpp>
 #include <MC/SimulatedPlayer.hpp>
+#include <array>
+#include <cstdint>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
+#include "AsyncFileWriter.h"
 #include "CommandHelper.h"
 #include "DynamicCommandAPI.h"
-#include "ScheduleAPI.h"
+#include "SimScript.h"
 
 namespace trapdoor {
+    enum class SimActionType : uint8_t {
+        Interact,
+        Attack,
+        DestroyOn,
+        Destroy,
+        Jump,
+        Use,
+        UseOn,
+        Script,  // 执行一段编译好的动作序列，由序列自己决定下次执行的时间
+    };
+
+    // 模拟玩家的一个周期动作，通过槽位下标引用玩家
+    struct SimAction {
+        SimActionType type = SimActionType::Jump;
+        bool active = false;
+        uint32_t slot = 0;
+        uint32_t generation = 0;  // 每次释放加一，时间轮里残留的旧记录据此失效
+        int interval = 1;
+        int remain = -1;  // 剩余执行次数，-1表示无限
+        uint64_t due = 0;
+        int itemId = 0;
+        BlockPos pos;
+        ActorUniqueID target;
+        uint32_t program = 0;  // Script动作使用的字节码下标
+        SimScriptState script;
+    };
+
+    // 单个假人的开销统计
+    struct SimCost {
+        int64_t actionTime = 0;     // 执行计划动作的时间(us)
+        int64_t actorTickTime = 0;  // 假人自己Actor::tick的时间(us)
+        uint32_t actions = 0;
+        uint32_t chunksEntered = 0;  // 跨区块时新进入模拟距离的区块数
+
+        inline int64_t total() const { return actionTime + actorTickTime; }
+
+        inline void add(const SimCost& rhs) {
+            actionTime += rhs.actionTime;
+            actorTickTime += rhs.actorTickTime;
+            actions += rhs.actions;
+            chunksEntered += rhs.chunksEntered;
+        }
+    };
+
     class SimPlayerManager {
+        static constexpr uint32_t NO_ACTION = UINT32_MAX;
+        static constexpr size_t WHEEL_SIZE = 256;  // 必须是2的幂
+        static constexpr uint64_t INV_DEBOUNCE_TICKS = 20;
+        static constexpr uint64_t INV_MAX_DELAY_TICKS = 200;
+        static constexpr uint64_t SNAPSHOT_DEBOUNCE_TICKS = 20;
+        static constexpr uint64_t SNAPSHOT_REFRESH_TICKS = 1200;
+        static constexpr uint32_t SNAPSHOT_MAGIC = 0x4c505354;  // "TSPL"
+        static constexpr uint32_t SNAPSHOT_VERSION = 1;
+        static constexpr const char* SNAPSHOT_PATH = "./plugins/trapdoor/sim/players.bin";
+        static constexpr uint64_t COST_WINDOW_TICKS = 200;
+        static constexpr int SIM_CHUNK_RADIUS = 4;  // 估算区块加载用的模拟距离，取服务端默认值
+
         struct SimInfo {
             std::string name;
-            SimulatedPlayer* simPlayer;
-            ScheduleTask task;
+            SimulatedPlayer* simPlayer = nullptr;
+            uint32_t action = NO_ACTION;  // 当前动作在actions中的下标
+            bool invDirty = false;        // 背包有还没保存的变化
+            uint64_t invDirtySince = 0;
+            uint64_t invChangedAt = 0;
+            std::string invBlob;  // 最近一次编码的背包
+            SimCost cost;         // 当前窗口
+            SimCost lastCost;     // 上一个完整窗口
+            SimCost profileCost;  // /prof sim期间的累计
+            bool hasChunk = false;
+            int chunkX = 0;
+            int chunkZ = 0;
         };
 
-        void syncPlayerListToFile();
+        struct SimProgram {
+            std::string key;
+            std::vector<int32_t> code;
+            uint32_t refs = 0;  // 引用这份字节码的动作数
+        };
+        // stepScript依赖programs扩容时移动而不是复制元素
+        static_assert(std::is_nothrow_move_constructible<SimProgram>::value);
+
+        struct WheelEntry {
+            uint32_t action;
+            uint32_t generation;
+        };
 
        public:
         inline void setupCommandInstance(const DynamicCommandInstance* instance) {
@@ -26,6 +110,10 @@ namespace trapdoor {
 
         void addPlayersInCache();
 
+        // 关服时在世界卸载之前调用，不等防抖立即保存，并等后台线程写完
+        void flushOnStop();
+
+        // 每gt推进一格时间轮，执行到期的动作
         void tick();
 
         void processDieEvent(const std::string& name);
@@ -41,7 +129,7 @@ namespace trapdoor {
         ActionResult behavior(const std::string& name, const std::string& behType, const Vec3& vec);
 
         ActionResult addPlayer(const std::string& name, const BlockPos& p, int dimID,
-                               Player* origin);
+                               Player* origin, bool readInvFile = true);
 
         ActionResult removePlayer(const std::string& name);
 
@@ -68,16 +156,89 @@ namespace trapdoor {
 
         ActionResult dropItem(const std::string& name, int itemId);
 
+        // 执行./plugins/trapdoor/sim/scripts/<scriptName>.txt里的动作序列，可以同时交给多个玩家
+        ActionResult runScriptFile(const std::vector<std::string>& names,
+                                   const std::string& scriptName);
+
+        // 直接执行命令里给出的动作序列
+        ActionResult runScript(const std::vector<std::string>& names, const std::string& source);
+
         void cancel(const std::string& name);
 
         void stopAction(const std::string& name);
 
         bool checkSurvival(const std::string& name);
 
+        // 给Actor::tick的钩子用，没有假人时连isPlayer都不用调用
+        inline bool hasSimPlayers() const { return !this->actorSlots.empty(); }
+
+        // 给Actor::tick的钩子用，不是假人返回-1
+        int32_t slotOf(const Actor* actor) const;
+
+        void recordActorTick(int32_t slot, int64_t time, const Vec3& pos);
+
+        void beginProfile();
+
+        // 按每gt开销从高到低输出/prof sim期间每个假人的统计
+        void printProfile(size_t rounds);
+
        private:
         void refreshCommandSoftEnum();
 
-        std::unordered_map<std::string, SimInfo> simPlayers;
+        SimInfo* findInfo(const std::string& name);
+
+        // 立即执行一次，repType不为0时再按interval加入时间轮重复times次
+        ActionResult schedule(const std::string& name, SimAction action, int repType,
+                              int interval, int times);
+
+        void cancelAction(SimInfo& info);
+
+        void saveInventory(SimInfo& info);
+
+        void flushInventories();
+
+        void addCost(SimInfo& info, int64_t actionTime, uint32_t actions);
+
+        // delay个gt后第一次执行
+        void enqueue(uint32_t slot, SimAction action, int delay);
+
+        uint32_t addProgram(const std::string& key, std::vector<int32_t> code);
+
+        // 没有动作引用时释放字节码，槽位留给下一个程序
+        void releaseProgram(uint32_t id);
+
+        void markSnapshotDirty();
+
+        void writeSnapshot();
+
+        bool readSnapshot();
+
+        bool restoreRecord(const char* p, const char* end);
+
+        ActionResult startProgram(const std::vector<std::string>& names, const std::string& key,
+                                  const std::string& source);
+
+        // 返回下次执行要等待的gt数，-1表示执行完毕
+        int stepScript(uint32_t program, SimScriptState& st, SimulatedPlayer* sim);
+
+        std::unordered_map<std::string, uint32_t> simPlayers;  // 名字 -> 槽位
+        std::vector<SimInfo> slots;
+        std::vector<uint32_t> freeSlots;
+        std::vector<SimAction> actions;
+        std::vector<uint32_t> freeActions;
+        std::array<std::vector<WheelEntry>, WHEEL_SIZE> wheel;
+        std::vector<WheelEntry> dueEntries;
+        std::vector<SimProgram> programs;  // 编译好的字节码，多个玩家共享
+        std::vector<uint32_t> freePrograms;
+        std::unordered_map<std::string, uint32_t> programIndex;
+        uint64_t currentTick = 0;
+        std::vector<uint32_t> dirtyInv;  // 背包待保存的槽位
+        AsyncFileWriter invWriter;
+        std::unordered_map<const Actor*, uint32_t> actorSlots;
+        bool profiling = false;
+        bool snapshotDirty = false;
+        uint64_t snapshotDirtySince = 0;
+        uint64_t lastSnapshot = 0;
         const DynamicCommandInstance* cmdInstance = nullptr;
     };
 }  // namespace trapdoor
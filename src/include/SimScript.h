@@ -0,0 +1,88 @@
+#ifndef TRAPDOOR_SIM_SCRIPT_H
+#define TRAPDOOR_SIM_SCRIPT_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace trapdoor {
+    // 模拟玩家动作序列的字节码，每条指令是操作码加固定个数的参数
+    enum class SimOp : int32_t {
+        Interact,
+        Attack,
+        Destroy,
+        DestroyOn,  // x y z
+        Jump,
+        Use,    // item
+        UseOn,  // item x y z
+        Set,    // item
+        LookAt,  // x y z
+        MoveTo,  // x y z
+        Stop,
+        Wait,    // ticks
+        Repeat,  // count，0表示无限
+        End,     // 循环体起点
+    };
+
+    int simOpArgc(SimOp op);
+
+    // 文本格式：一行或一个分号一条语句，#后面是注释
+    //   jump / attack / interact / destroy / stop
+    //   use [item] / set <item> / useon <item> <x> <y> <z> / destroyon <x> <y> <z>
+    //   lookat <x> <y> <z> / moveto <x> <y> <z>
+    //   wait <ticks>
+    //   repeat <count> ... end
+    bool compileSimScript(const std::string &src, std::vector<int32_t> &code, std::string &error);
+
+    // 一个玩家执行到哪里，多个玩家可以共享同一份字节码
+    struct SimScriptState {
+        static constexpr size_t MAX_LOOP_DEPTH = 4;
+
+        uint32_t pc = 0;
+        uint8_t depth = 0;
+        std::array<int32_t, MAX_LOOP_DEPTH> loops{};  // 每层循环剩余次数，-1表示无限
+    };
+
+    // 检查从文件读回的字节码和执行状态，保证runSimScript不会越界
+    // 规则和compileSimScript一致：参数完整、wait为正、循环嵌套合法，pc落在指令边界上
+    bool verifySimScript(const std::vector<int32_t> &code, const SimScriptState &st,
+                         std::string &error);
+
+    // 一个gt内最多执行的指令数，防止没有wait的无限循环卡住服务器
+    constexpr int SIM_SCRIPT_OPS_PER_TICK = 64;
+
+    // 从当前位置一直执行到wait，返回需要等待的gt数，执行完毕返回-1
+    // 动作指令交给exec(op, args)执行
+    template <typename Exec>
+    int runSimScript(const int32_t *code, size_t size, SimScriptState &st, Exec &&exec) {
+        for (int budget = 0; budget < SIM_SCRIPT_OPS_PER_TICK; budget++) {
+            if (st.pc >= size) return -1;
+            auto op = static_cast<SimOp>(code[st.pc]);
+            const int32_t *args = code + st.pc + 1;
+            st.pc += 1 + simOpArgc(op);
+            switch (op) {
+                case SimOp::Wait:
+                    return args[0];
+                case SimOp::Repeat:
+                    st.loops[st.depth++] = args[0] == 0 ? -1 : args[0];
+                    break;
+                case SimOp::End: {
+                    auto &remain = st.loops[st.depth - 1];
+                    if (remain < 0 || --remain > 0) {
+                        st.pc = static_cast<uint32_t>(args[0]);
+                    } else {
+                        --st.depth;
+                    }
+                    break;
+                }
+                default:
+                    exec(op, args);
+                    break;
+            }
+        }
+        return 1;
+    }
+}  // namespace trapdoor
+
+#endif
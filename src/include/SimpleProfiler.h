@@ -105,7 +105,7 @@ namespace trapdoor {
         int count;
     };
     struct SimpleProfiler {
-        enum Type { Normal, Chunk, PendingTick, Entity };
+        enum Type { Normal, Chunk, PendingTick, Entity, Sim };
         SimpleProfiler::Type type = Normal;
         bool profiling = false;
         size_t totalRound = 100;
@@ -3,8 +3,12 @@
 #define TRAPDOOR_SLIMECHUNKHELPER_H
 
 #include <set>
+#include <string>
+#include <unordered_map>
 
 #include "CommandHelper.h"
+#include "SlimeClusterFinder.h"
+#include "SlimeKernel.h"
 #include "TBlockPos.h"
 
 namespace trapdoor {
@@ -13,6 +17,11 @@ namespace trapdoor {
         int showRadius = 5;
         bool showSlime = false;
         std::set<trapdoor::ChunkPos> posList;
+        std::unordered_map<std::string, SlimeView> views;  // 每个主世界玩家周围的史莱姆位图
+        SlimeClusterFinder finder;
+        std::string finderRequester;
+
+        void deliverFinderResult();
 
        public:
         inline ActionResult ShowSlime(bool show) {
@@ -20,13 +29,21 @@ namespace trapdoor {
             return {"Slime chunk display is set to "+std::to_string(show), true};
         }
 
-        void updateChunkPosList();
+        // 玩家跨过区块边界时只增量更新对应的位图，返回要显示的区块是否有变化
+        bool updateChunkPosList();
 
         void HeavyTick();
 
         ActionResult setRadius(int r);
 
         ActionResult draw();
+
+        // 在以玩家所在区块为中心、边长2 * range的区域内找史莱姆区块最多的窗口
+        ActionResult startFind(Player *player, int range, int window);
+
+        ActionResult printFindStatus() const;
+
+        ActionResult cancelFind();
     };
 }  // namespace trapdoor
 
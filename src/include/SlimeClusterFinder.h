@@ -0,0 +1,67 @@
+#ifndef TRAPDOOR_SLIME_CLUSTER_FINDER_H
+#define TRAPDOOR_SLIME_CLUSTER_FINDER_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace trapdoor {
+    // 以(x,z)为中心、边长2 * window + 1的正方形区块窗口内有count个史莱姆区块
+    struct SlimeCluster {
+        int x = 0;
+        int z = 0;
+        int count = 0;
+    };
+
+    // 在工作线程上搜索史莱姆区块最密集的窗口，不访问任何游戏对象
+    // 区域按行切成条带，工作线程用原子计数器领取条带，每行用滑动窗口求和
+    class SlimeClusterFinder {
+       public:
+        static constexpr size_t TOP_K = 10;
+        static constexpr int STRIP_ROWS = 64;
+        // 在开着的服务器上跑，最多用这么多个线程
+        static constexpr size_t MAX_WORKERS = 4;
+
+        ~SlimeClusterFinder();
+
+        // 搜索窗口中心在[minX, minX + width) x [minZ, minZ + height)内的所有窗口
+        bool start(int minX, int minZ, int width, int height, int window, size_t threads);
+
+        void cancel();
+
+        inline bool isRunning() const { return this->running; }
+
+        // 搜索结束且结果还没有取走
+        inline bool hasResult() const { return this->finished.load(); }
+
+        // 已完成的行占比
+        double progress() const;
+
+        // 按数量从大到小排序，互相重叠的窗口只保留最好的一个
+        std::vector<SlimeCluster> takeResults();
+
+        inline int getWindow() const { return this->window; }
+
+       private:
+        void work();
+
+        void scanStrip(int strip, std::vector<SlimeCluster> &heap);
+
+        void join();
+
+        int minX = 0, minZ = 0, width = 0, height = 0, window = 0;
+        bool running = false;
+        std::vector<std::thread> workers;
+        std::atomic<int> nextStrip{0};
+        std::atomic<size_t> rowsDone{0};
+        std::atomic<size_t> activeWorkers{0};
+        std::atomic<bool> stop{false};
+        std::atomic<bool> finished{false};
+        std::mutex resultLock;
+        std::vector<SlimeCluster> candidates;
+    };
+}  // namespace trapdoor
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef TRAPDOOR_SLIME_KERNEL_H
+#define TRAPDOOR_SLIME_KERNEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace trapdoor {
+    // 史莱姆区块判定：以(x * 0x1f1f1f1f) ^ z为种子的MT19937的第一个输出模10为0
+    // 第一个输出只依赖状态字0、1、397，所以只需要算397步初始化，不用构造完整的624字状态
+    uint32_t mt19937FirstOutput(uint32_t seed);
+
+    inline uint32_t slimeSeed(int x, int z) {
+        return (static_cast<uint32_t>(x) * 0x1f1f1f1fu) ^ static_cast<uint32_t>(z);
+    }
+
+    inline bool isSlimeChunk(int x, int z) { return mt19937FirstOutput(slimeSeed(x, z)) % 10 == 0; }
+
+    // 批量计算一行区块[x0, x0 + count)在z上的结果，out[i]对应x0 + i，有SIMD时一次算多个种子
+    void slimeChunkRow(int x0, int z, size_t count, uint8_t *out);
+
+    // 当前批量路径使用的指令集，给基准测试输出用
+    const char *slimeKernelName();
+
+    // 以(cx,cz)为中心的[cx - r, cx + r) x [cz - r, cz + r)区块的史莱姆位图
+    // 按世界坐标对边长取模环形存放，中心移动时只重算新进入的行和列
+    class SlimeView {
+       public:
+        // 返回位图是否有变化
+        bool moveTo(int cx, int cz, int r);
+
+        bool get(int x, int z) const;
+
+        template <typename F>
+        void forEach(F &&f) const {
+            for (int z = this->cz - this->radius; z < this->cz + this->radius; z++) {
+                for (int x = this->cx - this->radius; x < this->cx + this->radius; x++) {
+                    if (this->get(x, z)) f(x, z);
+                }
+            }
+        }
+
+       private:
+        size_t index(int x, int z) const;
+        void set(int x, int z, bool v);
+        void fillRow(int z, int x0, int x1);
+
+        int cx = 0;
+        int cz = 0;
+        int radius = -1;
+        std::vector<uint64_t> bits;
+    };
+}  // namespace trapdoor
+
+#endif
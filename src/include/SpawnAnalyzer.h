@@ -4,34 +4,77 @@
 
 #ifndef TRAPDOOR_SPAWNANALYZER_H
 #define TRAPDOOR_SPAWNANALYZER_H
+#include <array>
+#include <cstdint>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "CommandHelper.h"
 #include "TBlockPos.h"
 namespace trapdoor {
+    enum class SpawnReject : uint8_t { Light = 0, Space = 1, Cap = 2, Distance = 3, Count = 4 };
+
+    struct SpawnAttemptStats {
+        uint32_t attempts = 0;
+        uint32_t success = 0;
+        std::array<uint32_t, static_cast<size_t>(SpawnReject::Count)> rejected{};
+    };
+
+    // 密度从EntityIndex里按区块读取，每samplingRate gt采样一次
+    // 生物类型统一使用EntityIndex驻留的类型id，各统计量以类型id为下标
     class SpawnAnalyzer {
        public:
         static const int SAMPLING_RARE = 10;
         SpawnAnalyzer() = default;
-        void AddMob(Mob* mob, const std::string& name, bool surface);
+        void AddMob(Mob* mob, bool surface);
         void tick();
         ActionResult clear();
-        ActionResult start(int id, const TBlockPos2& pos);
+        ActionResult start(int id, const TBlockPos2& pos, int rate = SAMPLING_RARE);
         ActionResult stop();
         ActionResult printResult() const;
 
+        // 以下由刷怪流程的hook调用，用来统计刷怪尝试和失败原因
+        void onMobToSpawn(const void* mobData, int dim, int cx, int cz);
+        void onPositionChecked(bool ok, bool nearPlayer, int dim, int cx, int cz);
+        void onMobSpawned(bool success);
+
+        // 插件自己采样刷怪概率时不计入统计
+        inline void mute(bool m) { this->muted = m; }
+
+        // hook里先判断，没在统计时不做额外的计算
+        inline bool isActive() const { return this->inAnalyzing && !this->muted; }
+
        private:
         void collectDensityInfo();
+        bool inWindow(int dim, int cx, int cz) const;
+        void reject(SpawnReject reason);
+        SpawnAttemptStats* currentMob();
         bool inAnalyzing = false;
         int dimensionID = 0;
+        int samplingRate = SAMPLING_RARE;
         TBlockPos2 centerChunkPos;
         size_t tick_count = 0;
-        std::unordered_map<std::string, size_t> surfaceMobs;
-        std::unordered_map<std::string, size_t> caveMobs;
+        size_t sample_count = 0;
+        std::vector<size_t> surfaceMobs;
+        std::vector<size_t> caveMobs;
+
+        std::vector<size_t> surfaceMobsPerSample;
+        std::vector<size_t> caveMobsPerSample;
+
+        struct PendingAttempt {
+            uint64_t chunk = 0;
+            uint16_t type = 0xffff;
+            bool hasType = false;
+            bool awaitingSpawn = false;
+        };
 
-        std::unordered_map<std::string, size_t> surfaceMobsPerTick;
-        std::unordered_map<std::string, size_t> caveMobsPerTick;
+        bool muted = false;
+        PendingAttempt current;
+        std::unordered_map<uint64_t, SpawnAttemptStats> chunkAttempts;
+        std::vector<SpawnAttemptStats> mobAttempts;
+        std::vector<std::string> attemptMobNames;
+        std::unordered_map<const void*, uint16_t> ruleTypes;
     };
 
 }  // namespace trapdoor
@@ -2,6 +2,13 @@
 #define TRAPDOOR_SPAWN_HELPER_H
 #include <MC/ActorDefinitionIdentifier.hpp>
 #include <MC/Player.hpp>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "CommandHelper.h"
 
@@ -35,22 +42,95 @@ namespace trapdoor {
 
     ActionResult forceSpawn(Player * p, const ActorDefinitionIdentifier *id, const BlockPos &pos);
 
+    enum class SpawnFloorState : uint8_t { Safe = 0, Blocked = 1, Spawnable = 2 };
+
+    // 一个可刷怪的地面，Blocked表示能选出生物但生成位置检查不通过
+    struct SpawnFloor {
+        int16_t y = 0;
+        uint8_t brightness = 0;  // 地面上方方块的原始亮度
+        bool surface = false;
+        SpawnFloorState state = SpawnFloorState::Safe;
+        uint8_t mob = 0xff;  // 采样最多的生物在mobNames中的下标
+    };
+
+    // 一个区块内16x16个柱子的分析结果，按x * 16 + z存放
+    struct SpawnChunkColumns {
+        uint64_t computedAt = 0;
+        std::array<std::vector<SpawnFloor>, 256> columns;
+    };
+
+    // 区域刷怪热力图，结果按区块缓存，分摊到多个游戏刻计算
     class SpawnHelper {
-        std::vector<BlockPos> verticalSpawnPositions;
+       public:
+        void lightTick();
+
+        void heavyTick();
+
+        ActionResult showChunkRadius(Player *player, int radius);
+
+        ActionResult showArea(Player *player, const BlockPos &from, const BlockPos &to);
+
+        ActionResult printInfo();
+
+        ActionResult clear();
+
+       private:
+        void select(int dim, int minX, int minY, int minZ, int maxX, int maxY, int maxZ);
+
+        // 把选区内未计算或已过期的区块加入计算队列
+        void queueStaleChunks();
+
+        void computeChunk(int cx, int cz, SpawnChunkColumns &res);
+
+        uint8_t internMob(const std::string &name);
+
+        void draw();
+
         bool enable = false;
         int dimensionID = 0;
-        unsigned long long gameTick;
+        int minX = 0, minY = 0, minZ = 0, maxX = 0, maxY = 0, maxZ = 0;
+        std::array<std::unordered_map<uint64_t, SpawnChunkColumns>, 3> cache;
+        std::deque<uint64_t> pending;
+        std::vector<std::string> mobNames;
+        std::unordered_map<std::string, uint8_t> mobIds;
+    };
 
+    // 按维度、按刷怪池统计生物数量，数据来自增量维护的EntityIndex，不扫描实体
+    // 每SAMPLE_INTERVAL gt采样一次存进环形的时间序列，只在设置了上限或者最近被查看过时记录
+    class MobCapMonitor {
        public:
-        inline void setAble(bool able) { this->enable = able; }
-
-        inline bool isEnable() const { return this->enable; }
+        static constexpr size_t HISTORY = 600;
+        static constexpr int SAMPLE_INTERVAL = 20;
 
         void tick();
 
-        void draw();
+        ActionResult printSummary(int dim) const;
+
+        ActionResult setCap(int pool, int cap);
+
+        std::string getHUDText(int dim) const;
+
+       private:
+        struct PoolSeries {
+            std::vector<uint32_t> samples;
+            size_t head = 0;
+            size_t count = 0;
+            uint32_t peak = 0;
+            size_t cappedSamples = 0;  // 达到上限的采样点数
+            uint64_t lastHit = 0;      // 最后一次从上限以下到达上限的游戏刻
+        };
+
+        int poolOf(uint16_t type);
+
+        void sample(uint64_t gt);
+
+        std::string poolLabel(int pool) const;
 
-        void updateVerticalSpawnPositions(const BlockPos &pos, Player *player);
+        std::vector<int> typePools;  // -2未解析 -1不属于任何刷怪池
+        std::array<std::map<int, uint32_t>, 3> current;
+        std::array<std::map<int, PoolSeries>, 3> series;
+        std::map<int, uint32_t> caps;
+        std::map<int, std::vector<uint16_t>> poolTypes;
     };
 
 }  // namespace trapdoor
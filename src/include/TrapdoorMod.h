@@ -2,13 +2,16 @@
 #define _TRAPDOOR_TRAPDOOR_H_
 
 #include "Config.h"
+#include "EntityIndex.h"
 #include "HUDHelper.h"
 #include "HopperCounter.h"
 #include "HsaHelper.h"
+#include "InventoryTool.h"
 #include "LoggerAPI.h"
 #include "SimPlayerHelper.h"
 #include "SlimeChunkHelper.h"
 #include "SpawnAnalyzer.h"
+#include "SpawnHelper.h"
 #include "VillageHelper.h"
 
 namespace trapdoor {
@@ -40,6 +43,14 @@ namespace trapdoor {
 
         inline SlimeChunkHelper &getSlimeChunkHelper() { return this->slimeChunkHelper; }
 
+        inline SpawnHelper &getSpawnHelper() { return this->spawnHelper; }
+
+        inline EntityIndex &getEntityIndex() { return this->entityIndex; }
+
+        inline MobCapMonitor &getMobCapMonitor() { return this->mobCapMonitor; }
+
+        inline InventoryIndex &getInventoryIndex() { return this->inventoryIndex; }
+
        private:
         VillageHelper villageHelper;
         HsaManager hsaManager;
@@ -49,6 +60,10 @@ namespace trapdoor {
         SimPlayerManager simPlayerManager;
         SpawnAnalyzer spawnAnalyzer;
         SlimeChunkHelper slimeChunkHelper;
+        SpawnHelper spawnHelper;
+        EntityIndex entityIndex;
+        MobCapMonitor mobCapMonitor;
+        InventoryIndex inventoryIndex;
     };
 
     Logger &logger();
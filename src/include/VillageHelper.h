@@ -2,19 +2,64 @@
 #define TRAPDOOR_VILLAGE_HELPER_H
 
 #include <MC/Village.hpp>
+#include <array>
+#include <functional>
+#include <map>
 #include <unordered_map>
+#include <vector>
 
 #include "CommandHelper.h"
+#include "TVec3.h"
+#include "VillageIndex.h"
+#include "VillageTimeline.h"
 
 namespace trapdoor {
+    enum class VillageEvent { FirstSeen, Updated, Unloaded };
+
+    // 村庄的缓存信息，除village指针外都是快照数据，可以随时安全读取
+    struct VillageInfo {
+        int vid = 0;
+        std::string uuid;
+        std::array<uint64_t, 2> rawUuid{};  // 核对村庄指针时直接比较，不用格式化字符串
+        Village* village = nullptr;  // 只有在村庄对象存活时才非空
+        uint64_t lastTick = 0;       // 最后一次tick的游戏刻
+        uint64_t lastRefresh = 0;    // 派生数据最后一次刷新的游戏刻
+        TVec3 boundMin{};
+        TVec3 boundMax{};
+        TVec3 center{};
+        float radius = 0;
+        std::array<size_t, 4> dwellerCount{};  // villager golem cat unknown
+        std::array<size_t, 3> poiCount{};      // bed alarm work
+        size_t bedCount = 0;
+    };
+
+    typedef std::function<void(VillageEvent, const VillageInfo&)> VillageListener;
+
     class VillageHelper {
        private:
         void setVillagerHeadInfo();
 
+        void refreshVillageInfo(VillageInfo& info, uint64_t gt);
+
+        void removeVillage(std::map<int, VillageInfo>::iterator it);
+
+        void notify(VillageEvent event, const VillageInfo& info);
+
        public:
         void heavyTick();
         void lightTick();
-        void insertVillage(Village* village);
+        void onVillageTick(Village* village);
+        void onVillageDestroy(Village* village);
+        void onDefenderSpawned(Village* village, int64_t golem, const TBlockPos& pos);
+
+        inline void subscribe(const VillageListener& listener) {
+            this->listeners.push_back(listener);
+        }
+
+        inline const std::map<int, VillageInfo>& getVillages() const { return this->villages; }
+
+        inline const VillageIndex& getIndex() const { return this->index; }
+
         // action
         ActionResult listTickingVillages(bool details);
 
@@ -30,12 +75,32 @@ namespace trapdoor {
 
         ActionResult printDetails(int vid, const Vec3& pos);
 
+        ActionResult printTimeline(int vid, int duration);
+
+        ActionResult exportTimeline(int vid, int duration);
+
         //  ActionResult Goto(int vid, const Vec3& pos);
 
         bool ShowVillageInfo(Player* p, Actor* actor);
 
        private:
-        std::map<int, Village*> vs_;
+        struct VidRecord {
+            int vid;
+            uint64_t lastSeen;
+        };
+
+        int getVID(const std::string& uuid, uint64_t gt);
+
+        // 按指针找VID，并核对UUID，对象地址被新村庄复用时清掉旧记录，返回-1
+        int findVID(Village* village);
+
+        std::map<int, VillageInfo> villages;
+        VillageIndex index;
+        VillageTimeline timeline;
+        std::unordered_map<Village*, int> ptrIndex;
+        std::unordered_map<std::string, VidRecord> vidPool;
+        int nextVid = 1;
+        std::vector<VillageListener> listeners;
         bool showCenter = false;
         bool showIronSpawn = false;
         bool showBounds = false;
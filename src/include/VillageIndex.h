@@ -0,0 +1,73 @@
+#ifndef TRAPDOOR_VILLAGE_INDEX_H
+#define TRAPDOOR_VILLAGE_INDEX_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "TBlockPos.h"
+#include "TVec3.h"
+
+namespace trapdoor {
+    struct VillagePOI {
+        TBlockPos pos;
+        int type = 0;       // 0 bed 1 alarm 2 work
+        int64_t owner = 0;  // ActorUniqueID
+    };
+
+    // 以区块为桶的村庄空间索引，范围、中心和POI都按所在区块分桶
+    // 由VillageHelper在村庄刷新/卸载时增量维护
+    class VillageIndex {
+       public:
+        void update(int vid, const TVec3 &boundMin, const TVec3 &boundMax, const TVec3 &center,
+                    std::vector<VillagePOI> pois, std::vector<int64_t> dwellers);
+
+        void remove(int vid);
+
+        void clear();
+
+        // 包含该位置的村庄，没有返回-1
+        int containing(const TVec3 &pos) const;
+
+        // 中心离该位置最近的村庄，没有返回-1
+        int nearest(const TVec3 &pos, float *distance = nullptr) const;
+
+        // 该位置上的POI，没有返回nullptr
+        const VillagePOI *poiAt(const TBlockPos &pos, int *vid = nullptr) const;
+
+        // 居民所属的村庄，没有返回-1
+        int dwellerVillage(int64_t uid) const;
+
+        inline size_t size() const { return this->entries.size(); }
+
+       private:
+        struct Entry {
+            TVec3 boundMin;
+            TVec3 boundMax;
+            TVec3 center;
+            std::vector<uint64_t> boundCells;
+            std::vector<VillagePOI> pois;
+            std::vector<int64_t> dwellers;
+        };
+
+        struct Cell {
+            std::vector<int> bounds;
+            std::vector<int> centers;
+            std::vector<std::pair<int, size_t>> pois;  // vid, index of Entry::pois
+
+            inline bool empty() const { return bounds.empty() && centers.empty() && pois.empty(); }
+        };
+
+        void unlinkBounds(int vid, const Entry &entry);
+        void linkBounds(int vid, Entry &entry);
+        void unlinkPOIs(int vid, const Entry &entry);
+        void linkPOIs(int vid, const Entry &entry);
+        void eraseFromCell(uint64_t key, std::vector<int> Cell::*list, int vid);
+
+        std::unordered_map<int, Entry> entries;
+        std::unordered_map<uint64_t, Cell> cells;
+        std::unordered_map<int64_t, int> dwellerIndex;
+    };
+}  // namespace trapdoor
+
+#endif
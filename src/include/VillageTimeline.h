@@ -0,0 +1,94 @@
+#ifndef TRAPDOOR_VILLAGE_TIMELINE_H
+#define TRAPDOOR_VILLAGE_TIMELINE_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "TBlockPos.h"
+#include "VillageIndex.h"
+
+namespace trapdoor {
+    enum class VillageRecordType : uint8_t {
+        GolemSpawn = 0,
+        POIClaim = 1,
+        POILost = 2,
+        DwellerJoin = 3,
+        DwellerLeave = 4,
+        Count = 5,
+    };
+
+    const char *villageRecordName(VillageRecordType type);
+
+    // 定长记录，POI类型只对POI相关的记录有意义
+    struct VillageRecord {
+        uint64_t tick = 0;
+        int64_t actor = 0;
+        int32_t x = 0, y = 0, z = 0;
+        VillageRecordType type = VillageRecordType::GolemSpawn;
+        uint8_t poiType = 0;
+    };
+
+    // 每个村庄一个环形缓冲区，写满后覆盖最旧的记录
+    class VillageLog {
+       public:
+        static constexpr size_t CAPACITY = 2048;
+
+        void push(const VillageRecord &rec);
+
+        inline size_t size() const { return this->count; }
+
+        // 按时间顺序的第i条记录
+        inline const VillageRecord &at(size_t i) const {
+            return this->records[(this->head + CAPACITY - this->count + i) % CAPACITY];
+        }
+
+        // 游戏刻在[begin,end]内的记录下标范围[first,last)
+        std::pair<size_t, size_t> range(uint64_t begin, uint64_t end) const;
+
+       private:
+        std::vector<VillageRecord> records;
+        size_t head = 0;  // 下一条记录的写入位置
+        size_t count = 0;
+    };
+
+    class VillageTimeline {
+       public:
+        void recordGolemSpawn(int vid, uint64_t gt, int64_t golem, const TBlockPos &pos);
+
+        // 与上一次的POI分配做差分，生成认领/丢失记录
+        void updatePOIs(int vid, uint64_t gt, const std::vector<VillagePOI> &pois);
+
+        // 与上一次的居民列表做差分，生成加入/离开记录
+        void updateDwellers(int vid, uint64_t gt, const std::vector<int64_t> &dwellers);
+
+        // 村庄卸载后丢弃差分用的快照，下次加载时不产生虚假的记录
+        void forgetSnapshot(int vid);
+
+        // VID过期回收后释放该村庄的全部记录
+        void forgetVillage(int vid);
+
+        const VillageLog *getLog(int vid) const;
+
+        std::array<size_t, static_cast<size_t>(VillageRecordType::Count)> countInRange(
+            int vid, uint64_t begin, uint64_t end) const;
+
+        bool exportCSV(int vid, uint64_t begin, uint64_t end, const std::string &path) const;
+
+       private:
+        struct Snapshot {
+            bool hasPOIs = false;
+            bool hasDwellers = false;
+            std::unordered_map<int64_t, std::array<TBlockPos, 3>> pois;  // owner -> bed alarm work
+            std::unordered_set<int64_t> dwellers;
+        };
+
+        std::unordered_map<int, VillageLog> logs;
+        std::unordered_map<int, Snapshot> snapshots;
+    };
+}  // namespace trapdoor
+
+#endif